@@ -0,0 +1 @@
+../../../PajdegCore/Pod/Source/src/pd_work_queue.h
\ No newline at end of file
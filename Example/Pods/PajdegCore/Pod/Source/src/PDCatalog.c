@@ -171,6 +171,18 @@ PDCatalogRef PDCatalogCreateWithParserForObject(PDParserRef parser, PDObjectRef
     return catalog;
 }
 
+PDCatalogRef PDCatalogCreateWithParserForObjectAndPages(PDParserRef parser, PDObjectRef catalogObject, PDInteger *kids, PDInteger count)
+{
+    PDCatalogRef catalog = PDAlloc(sizeof(struct PDCatalog), PDCatalogDestroy, false);
+    catalog->parser = parser;
+    catalog->object = PDRetain(catalogObject);
+    catalog->count = count;
+    catalog->capacity = count;
+    catalog->kids = kids;
+    catalog->pages.collection = false;
+    return catalog;
+}
+
 PDInteger PDCatalogGetObjectIDForPage(PDCatalogRef catalog, PDInteger pageNumber)
 {
     PDAssert(pageNumber > 0 && pageNumber <= catalog->count);
@@ -60,6 +60,19 @@
  */
 extern PDCatalogRef PDCatalogCreateWithParserForObject(PDParserRef parser, PDObjectRef catalog);
 
+/**
+ Set up a catalog with a PDParser, a catalog object, and a known list of pages.
+ 
+ Unlike PDCatalogCreateWithParserForObject(), the page tree is not walked at all; this is used when the pages are already known, e.g. from an index sidecar (see PDParserCreateWithStreamAndIndex()).
+ 
+ @param parser  The PDParserRef instance.
+ @param catalog The catalog object.
+ @param kids    Object IDs of the pages, in page order. The catalog takes ownership of the (malloc'd) array.
+ @param count   Number of pages.
+ @return The PDCatalog instance.
+ */
+extern PDCatalogRef PDCatalogCreateWithParserForObjectAndPages(PDParserRef parser, PDObjectRef catalog, PDInteger *kids, PDInteger count);
+
 /**
  Determine the object ID for the given page number, or throw an assertion if the page number is out of bounds.
  
@@ -739,6 +739,47 @@ typedef struct PDString  *PDStringRef;
  */
 typedef struct PDPipe       *PDPipeRef;
 
+/**
+ Pipe options.
+
+ @ingroup PDPIPE
+
+ Options are given when a pipe is created, and are bitwise OR'd together. They remain in effect for the lifetime of the pipe.
+ */
+typedef enum {
+    PDPipeOptionsNone               = 0,        ///< default behavior
+    PDPipeOptionMemoryMappedInput   = 1 << 0,   ///< memory map the input file; the stream heap points straight into the mapping, and buffer growth, reversed reads and branch fetches do not copy anything (falls back to regular reads if the input cannot be mapped)
+    PDPipeOptionIncrementalUpdate   = 1 << 1,   ///< write the output as an incremental update: the input is copied untouched, followed by the modified, added and deleted objects and a new xref section whose /Prev points at the original one
+    PDPipeOptionReadAhead           = 1 << 2,   ///< read the input ahead of the parser on a helper thread (ignored for memory mapped and non-regular input)
+    PDPipeOptionWriteBehind         = 1 << 3,   ///< write the output on a helper thread, while the parser carries on producing more (ignored for non-regular output)
+    PDPipeOptionRecoverXRefs        = 1 << 4,   ///< if the input's xref tables or streams cannot be read, reconstruct the xref table by sweeping the input for object definitions and trailers, rather than failing (ignored for incremental updates)
+    PDPipeOptionIndexSidecar        = 1 << 5,   ///< keep an index of the input's xref tables, trailer and page list in a sidecar file next to it (the input path with ".pdidx" appended), and take everything from the index rather than the input whenever the input is unchanged (ignored for buffer and non-regular input)
+    PDPipeOptionPackObjects         = 1 << 6,   ///< pack dictionary and array objects without streams into new object streams, and write the xref as a compressed stream with minimal field widths; documents older than PDF 1.5 get a /Version entry in their catalog (ignored for incremental updates and encrypted input)
+} PDPipeOptions;
+
+/**
+ I/O statistics for a pipe.
+
+ @ingroup PDPIPE
+
+ The counters cover everything the pipe's twin stream did between the pipe being prepared and executed. Memory mapped and in-memory input is not counted as read; its pages are touched by the system, not by the stream.
+ */
+typedef struct PDIOStats    PDIOStats;
+struct PDIOStats {
+    PDSize bytesRead;           ///< number of bytes read from the input into memory; passed through content copied kernel side is only counted as written
+    PDSize bytesWritten;        ///< number of bytes written to the output
+    PDSize reads;               ///< number of read calls made on the input
+    PDSize writes;              ///< number of write calls made on the output
+    PDSize seeks;               ///< number of times the input was repositioned
+    PDSize reversedRebuilds;    ///< number of times the heap was reallocated and moved while reading backwards (e.g. looking for the xref table of a file with a large trailer)
+    PDSize reallocs;            ///< number of times the heap was grown
+    PDSize peakHeap;            ///< largest heap size, in bytes
+    PDSize branchFetches;       ///< number of branch fetches (out of band reads, e.g. resolving objects or reading object streams)
+    PDSize cacheHits;           ///< number of branch fetch block lookups served from the block cache
+    PDSize cacheMisses;         ///< number of branch fetch block lookups that required reading from the input
+    PDSize cacheEvictions;      ///< number of blocks evicted from the block cache
+};
+
 /**
  A task.
  
@@ -22,6 +22,8 @@
 // THE SOFTWARE.
 //
 
+#include <sys/mman.h>
+
 #include "Pajdeg.h"
 
 #include "pd_internal.h"
@@ -48,10 +50,14 @@ void PDObjectDestroy(PDObjectRef object)
     pd_stack_destroy(&object->def);
     
     if (object->ovrDef) free(object->ovrDef);
+    if (object->updDef) free(object->updDef);
     if (object->ovrStream && object->ovrStreamAlloc)
         free(object->ovrStream);
     if (object->refString) free(object->refString);
-    if (object->extractedLen != -1) free(object->streamBuf);
+    if (object->extractedLen != -1) {
+        if (object->streamMapLen) munmap(object->streamBuf, object->streamMapLen);
+        else free(object->streamBuf);
+    }
 }
 
 PDObjectRef PDObjectCreate(PDInteger obid, PDInteger genid)
@@ -217,6 +223,20 @@ void *PDObjectGetValue(PDObjectRef object)
     return object->inst ? object->inst : object->def;
 }
 
+pd_stack PDObjectCopyDefinitionsStack(PDObjectRef object)
+{
+    if (object->def) return pd_stack_copy(object->def);
+    if (object->inst == NULL) return NULL;
+    
+    // the object was constructed directly, so we generate the stack from its value
+    PDInteger cap = 64;
+    char *buf = malloc(cap);
+    PDInteger len = (*PDInstancePrinters[PDResolve(object->inst)])(object->inst, &buf, 0, &cap);
+    pd_stack stack = PDScannerGenerateStackFromFixedBuffer(pdfRoot, buf, len);
+    free(buf);
+    return stack;
+}
+
 void PDObjectSetValue(PDObjectRef object, void *value)
 {
     PDRetain(value);
@@ -236,8 +256,11 @@ PDCryptoInstanceRef PDObjectGetCryptoInstance(PDObjectRef object)
 
 void PDObjectInstantiate(PDObjectRef object)
 {
-    pd_stack s = object->def;
-    object->inst = PDInstanceCreateFromComplex(&s);
+    // objects constructed directly by the parser come with an instance, but still need their type and crypto instance set up
+    if (object->inst == NULL) {
+        pd_stack s = object->def;
+        object->inst = PDInstanceCreateFromComplex(&s);
+    }
     if (object->type == PDObjectTypeUnknown) {
         PDObjectDetermineType(object);
     }
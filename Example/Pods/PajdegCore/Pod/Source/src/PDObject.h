@@ -238,6 +238,16 @@ extern char *PDObjectGetStream(PDObjectRef object);
  */
 extern void *PDObjectGetValue(PDObjectRef object);
 
+/**
+ Copy the definitions stack of the given object. 
+ 
+ Objects fetched via the parser are normally constructed without a definitions stack, in which case one is generated from the object's value (so e.g. number formatting is normalized). This is for code working with the pd_stack representation; PDObjectGetValue() should be preferred.
+ 
+ @param object The object.
+ @return A definitions stack, which must be destroyed via pd_stack_destroy(), or NULL if the object has no value.
+ */
+extern pd_stack PDObjectCopyDefinitionsStack(PDObjectRef object);
+
 /**
  Set the value of the given object.
  
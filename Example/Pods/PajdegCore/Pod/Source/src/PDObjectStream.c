@@ -52,10 +52,7 @@ void PDObjectStreamDestroy(PDObjectStreamRef obstm)
     PDInteger i;
     PDObjectStreamElementRef elements = obstm->elements;
     for (i = 0; i < obstm->n; i++)
-        if (elements[i].type == PDObjectTypeString)
-            free(elements[i].def);
-        else
-            pd_stack_destroy((pd_stack *)&elements[i].def);
+        pd_stack_destroy((pd_stack *)&elements[i].def);
     free(elements);
     PDRelease(obstm->filter);
     if (obstm->constructs) {
@@ -89,6 +86,8 @@ PDObjectStreamRef PDObjectStreamCreateWithObject(PDObjectRef object)
     }
     
     obstm->elements = NULL;
+    obstm->buf = NULL;
+    obstm->len = 0;
     
     return obstm;
 }
@@ -128,6 +127,8 @@ void PDObjectStreamParseExtractedObjectStream(PDObjectStreamRef obstm, char *buf
     PDObjectStreamElementRef elements = obstm->elements = malloc(sizeof(struct PDObjectStreamElement) * n);
     
     len = obstm->ob->extractedLen;
+    obstm->buf = buf;
+    obstm->len = len;
     
     PDScannerRef osScanner = PDScannerCreateWithState(arbStream);
     osScanner->buf = buf;
@@ -135,36 +136,66 @@ void PDObjectStreamParseExtractedObjectStream(PDObjectStreamRef obstm, char *buf
     osScanner->boffset = 0;
     osScanner->bsize = len;
     
-    // header (obid offset * n)
+    // header (obid offset * n); definitions are scanned on demand, in PDObjectStreamGetElementAtIndex()
     for (i = 0; i < n; i++) {
         el = &elements[i];
         el->obid = PDIntegerFromString(&osScanner->buf[osScanner->boffset]);
         PDScannerPassSymbolCharacterType(osScanner, PDOperatorSymbolGlobWhitespace);
         el->offset = PDIntegerFromString(&osScanner->buf[osScanner->boffset]);
         PDScannerPassSymbolCharacterType(osScanner, PDOperatorSymbolGlobWhitespace);
+        el->type = PDObjectTypeNull;
+        el->def = NULL;
+        el->loaded = false;
     }
     
     // we should now be at the first object's definition, but we can't presume whitespace will be exact so we += 1 byte
     PDAssert(labs(obstm->first - osScanner->boffset) < 2);
     
-    // read definitions 
-    for (i = 0; i < n; i++) {
-        if (PDScannerPopStack(osScanner, (pd_stack *)&elements[i].def)) {
-            elements[i].type = PDObjectTypeFromIdentifier(as(pd_stack, elements[i].def)->info);
+    PDRelease(osScanner);
+}
+
+PDObjectStreamElementRef PDObjectStreamGetElementAtIndex(PDObjectStreamRef obstm, PDInteger index)
+{
+    PDObjectStreamElementRef el;
+    PDScannerRef osScanner;
+    PDInteger offset;
+    
+    if (index < 0 || index >= obstm->n) return NULL;
+    
+    el = &obstm->elements[index];
+    if (el->loaded) return el;
+    el->loaded = true;
+    
+    offset = obstm->first + el->offset;
+    if (el->offset < 0 || offset >= obstm->len) {
+        PDWarn("object #%ld has offset %ld in object stream #%ld, which is only %ld bytes long", el->obid, el->offset, obstm->ob->obid, obstm->len);
+        return el;
+    }
+    
+    osScanner = PDScannerCreateWithState(arbStream);
+    osScanner->buf = obstm->buf;
+    osScanner->fixedBuf = true;
+    osScanner->boffset = offset;
+    osScanner->bsize = obstm->len;
+    
+    if (PDScannerPopStack(osScanner, (pd_stack *)&el->def)) {
+        el->type = PDObjectTypeFromIdentifier(as(pd_stack, el->def)->info);
+    } else {
+        el->type = PDObjectTypeString;
+        char *str;
+        if (PDScannerPopString(osScanner, &str)) {
+            // definitions are always stacks; the string is kept as a lone key
+            pd_stack_push_key((pd_stack *)&el->def, str);
         } else {
-            elements[i].type = PDObjectTypeString;
-            char *str;
-            if (PDScannerPopString(osScanner, &str)) {
-                elements[i].def = str;
-            } else {
-                PDAssert(0); // crash = pdf is broken, and could not be scanned
-                elements[i].type = PDObjectTypeNull;
-                elements[i].def = NULL;
-            }
+            PDAssert(0); // crash = pdf is broken, and could not be scanned
+            el->type = PDObjectTypeNull;
+            el->def = NULL;
         }
     }
     
     PDRelease(osScanner);
+    
+    return el;
 }
 
 PDObjectRef PDObjectStreamGetObjectByID(PDObjectStreamRef obstm, PDInteger obid)
@@ -180,14 +211,7 @@ PDObjectRef PDObjectStreamGetObjectByID(PDObjectStreamRef obstm, PDInteger obid)
     elements = obstm->elements;
     for (i = 0; i < n; i++) {
         if (elements[i].obid == obid) {
-            ob = PDObjectCreate(obid, 0);
-            ob->crypto = obstm->ob->crypto;
-            ob->obclass = PDObjectClassCompressed;
-            ob->def = elements[i].def;
-            ob->type = elements[i].type;
-            elements[i].def = NULL;
-            PDSplayTreeInsert(obstm->constructs, obid, ob);
-            return ob;
+            return PDObjectStreamGetObjectAtIndex(obstm, i);
         }
     }
     
@@ -196,25 +220,27 @@ PDObjectRef PDObjectStreamGetObjectByID(PDObjectStreamRef obstm, PDInteger obid)
 
 PDObjectRef PDObjectStreamGetObjectAtIndex(PDObjectStreamRef obstm, PDInteger index)
 {
-    PDObjectStreamElementRef elements;
+    PDObjectStreamElementRef el;
+    PDObjectRef ob;
     
-    elements = obstm->elements;
     PDAssert(obstm->n > index);
     PDAssert(index > -1);
     
-    if (elements[index].def) {
-        PDObjectRef ob = PDObjectCreate(elements[index].obid, 0);
-        ob->crypto = obstm->ob->crypto;
-        ob->obclass = PDObjectClassCompressed;
-        ob->def = elements[index].def;
-        ob->type = elements[index].type;
-        elements[index].def = NULL;
-        PDSplayTreeInsert(obstm->constructs, elements[index].obid, ob);
-        //pd_btree_insert(&obstm->constructs, elements[index].obid, ob);
-        return ob;
-    }
+    el = &obstm->elements[index];
+    ob = PDSplayTreeGet(obstm->constructs, el->obid);
+    if (ob) return ob;
+    
+    PDObjectStreamGetElementAtIndex(obstm, index);
     
-    return PDSplayTreeGet(obstm->constructs, elements[index].obid);
+    ob = PDObjectCreate(el->obid, 0);
+    ob->crypto = obstm->ob->crypto;
+    ob->obclass = PDObjectClassCompressed;
+    ob->def = el->def;
+    ob->type = el->type;
+    el->def = NULL;
+    PDSplayTreeInsert(obstm->constructs, el->obid, ob);
+    //pd_btree_insert(&obstm->constructs, elements[index].obid, ob);
+    return ob;
     //pd_btree_fetch(obstm->constructs, elements[index].obid);
 }
 
@@ -229,6 +255,7 @@ void PDObjectStreamCommit(PDObjectStreamRef obstm)
     PDObjectStreamElementRef elements;
     char hbuf[64];
     char *content;
+    char **defs;
     
     if (obstm->constructs == NULL) return;
     
@@ -238,18 +265,27 @@ void PDObjectStreamCommit(PDObjectStreamRef obstm)
     offs = 0;
     headerlen = 0;
     
+    // the element definitions remain stacks; the stringified versions only live for the duration of the commit
+    defs = malloc(sizeof(char *) * n);
+    
     // stringify and update offsets
     for (i = 0; i < n; i++) {
-        if (elements[i].def == NULL) {
+        PDObjectStreamGetElementAtIndex(obstm, i);
+        pd_stack def = elements[i].def;
+        if (def == NULL) {
             PDObjectRef ob = PDSplayTreeGet(obstm->constructs, elements[i].obid);
-            len = PDObjectGenerateDefinition(ob, (char**)&elements[i].def, 0);
+            defs[i] = NULL;
+            len = PDObjectGenerateDefinition(ob, &defs[i], 0);
             len--; // objects add \n after def; don't want two \n's
         } else {
-//            if (PDObjectTypeString != elements[i].type) {
-                pd_stack def = elements[i].def;
-                elements[i].def = PDStringFromComplex(&def);
-//            }
-            len = strlen(elements[i].def);
+            if (def->type == PD_STACK_STRING) {
+                defs[i] = strdup(def->info);
+            } else {
+                pd_stack_set_global_preserve_flag(true);
+                defs[i] = PDStringFromComplex(&def);
+                pd_stack_set_global_preserve_flag(false);
+            }
+            len = strlen(defs[i]);
         }
         len++; // add a \n after every def
         elements[i].offset = offs;
@@ -266,7 +302,10 @@ void PDObjectStreamCommit(PDObjectStreamRef obstm)
     
     // generate stream
     len = headerlen + offs;
-    if (len == 0) return; // CLANG warnings
+    if (len == 0) { // CLANG warnings
+        free(defs);
+        return;
+    }
     content = malloc(len);
     
     // header
@@ -281,11 +320,13 @@ void PDObjectStreamCommit(PDObjectStreamRef obstm)
     
     // content
     for (i = 0; i < n; i++) {
-        memcpy(&content[offs], elements[i].def, elements[i].length);
+        memcpy(&content[offs], defs[i], elements[i].length);
         offs += elements[i].length;
         content[offs-1] = '\n';
         PDAssert(offs <= len);
+        free(defs[i]);
     }
+    free(defs);
     
     PDAssert(offs == len);
     
@@ -28,6 +28,36 @@
 
 #include "pd_internal.h"
 
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#   define PD_GLOB_SIMD_X86
+#   define PD_GLOB_SIMD_BLOCK  32
+#   define PD_GLOB_SIMD_FULL   0xffffffffU
+typedef __m256i PDGlobVector;
+#   define PDGlobLoad(p)       _mm256_loadu_si256((const __m256i *)(p))
+#   define PDGlobEq(v, c)      _mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)(c)))
+#   define PDGlobOr(a, b)      _mm256_or_si256(a, b)
+#   define PDGlobMask(v)       ((unsigned)_mm256_movemask_epi8(v))
+#elif defined(__SSE2__)
+#   include <emmintrin.h>
+#   define PD_GLOB_SIMD_X86
+#   define PD_GLOB_SIMD_BLOCK  16
+#   define PD_GLOB_SIMD_FULL   0xffffU
+typedef __m128i PDGlobVector;
+#   define PDGlobLoad(p)       _mm_loadu_si128((const __m128i *)(p))
+#   define PDGlobEq(v, c)      _mm_cmpeq_epi8(v, _mm_set1_epi8((char)(c)))
+#   define PDGlobOr(a, b)      _mm_or_si128(a, b)
+#   define PDGlobMask(v)       ((unsigned)_mm_movemask_epi8(v))
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#   include <arm_neon.h>
+#   define PD_GLOB_SIMD_NEON
+#   define PD_GLOB_SIMD_BLOCK  16
+typedef uint8x16_t PDGlobVector;
+#   define PDGlobLoad(p)       vld1q_u8((const uint8_t *)(p))
+#   define PDGlobEq(v, c)      vceqq_u8(v, vdupq_n_u8((uint8_t)(c)))
+#   define PDGlobOr(a, b)      vorrq_u8(a, b)
+#endif
+
 char *PDOperatorSymbolsWhitespace = "\x00\x09\x0A\x0C\x0D ";    // 0, 9, 10, 12, 13, 32 (character codes)
 char *PDOperatorSymbolsDelimiters = "()<>[]{}/%";               // (, ), <, >, [, ], {, }, /, % (characters)
 //char *PDOperatorSymbolsNumeric = "0123456789";                  // 0-9 (character range)
@@ -98,6 +128,114 @@ char PDOperatorSymbolGlobDefine(char *str)
             : PDOperatorSymbolGlobRegular);
 }
 
+short PDOperatorSymbolGlobHash(const char *str, PDInteger len)
+{
+    PDInteger i;
+    short hash = 0;
+    for (i = 0; i < len; i++) 
+        hash -= (PDOperatorSymbolGlob[(unsigned char)str[i]] - 1) * (unsigned char)str[i];
+    return 10 * abs(hash) + len;
+}
+
+// span modes; each describes which bytes end the span
+#define PDGlobSpanWhitespace        0   // anything but whitespace
+#define PDGlobSpanRegular           1   // whitespace, delimiters and backslash
+#define PDGlobSpanUntilDelimiter    2   // delimiters and backslash
+#define PDGlobSpanUntilNewline      3   // \r, \n and backslash
+
+static inline PDBool PDOperatorSymbolGlobStops(unsigned char c, int mode)
+{
+    switch (mode) {
+        case PDGlobSpanWhitespace:
+            return PDOperatorSymbolGlob[c] != PDOperatorSymbolGlobWhitespace;
+        case PDGlobSpanRegular:
+            return PDOperatorSymbolGlob[c] != PDOperatorSymbolGlobRegular || c == '\\';
+        case PDGlobSpanUntilDelimiter:
+            return PDOperatorSymbolGlob[c] == PDOperatorSymbolGlobDelimiter || c == '\\';
+        default:
+            return c == '\r' || c == '\n' || c == '\\';
+    }
+}
+
+#ifdef PD_GLOB_SIMD_BLOCK
+
+static inline PDGlobVector PDOperatorSymbolGlobVectorWhitespace(PDGlobVector v)
+{
+    return PDGlobOr(PDGlobOr(PDGlobOr(PDGlobEq(v, 0), PDGlobEq(v, ' ')),
+                             PDGlobOr(PDGlobEq(v, '\t'), PDGlobEq(v, '\n'))),
+                    PDGlobOr(PDGlobEq(v, '\f'), PDGlobEq(v, '\r')));
+}
+
+static inline PDGlobVector PDOperatorSymbolGlobVectorDelimiter(PDGlobVector v)
+{
+    return PDGlobOr(PDGlobOr(PDGlobOr(PDGlobOr(PDGlobEq(v, '('), PDGlobEq(v, ')')),
+                                      PDGlobOr(PDGlobEq(v, '<'), PDGlobEq(v, '>'))),
+                             PDGlobOr(PDGlobOr(PDGlobEq(v, '['), PDGlobEq(v, ']')),
+                                      PDGlobOr(PDGlobEq(v, '{'), PDGlobEq(v, '}')))),
+                    PDGlobOr(PDGlobEq(v, '/'), PDGlobEq(v, '%')));
+}
+
+#endif
+
+static inline PDSize PDOperatorSymbolGlobSpan(const char *buf, PDSize len, int mode)
+{
+    const unsigned char *ubuf = (const unsigned char *)buf;
+    PDSize i = 0;
+    
+#ifdef PD_GLOB_SIMD_BLOCK
+    // classify a block at a time; the first block containing a stop byte is finished by the scalar loop below (x86 pinpoints it directly from the byte mask)
+    PDGlobVector v, hit;
+    for (; i + PD_GLOB_SIMD_BLOCK <= len; i += PD_GLOB_SIMD_BLOCK) {
+        v = PDGlobLoad(&ubuf[i]);
+        switch (mode) {
+            case PDGlobSpanWhitespace:
+            case PDGlobSpanRegular:
+                hit = PDOperatorSymbolGlobVectorWhitespace(v);
+                if (mode == PDGlobSpanRegular) 
+                    hit = PDGlobOr(PDGlobOr(hit, PDGlobEq(v, '\\')), PDOperatorSymbolGlobVectorDelimiter(v));
+                break;
+            case PDGlobSpanUntilDelimiter:
+                hit = PDGlobOr(PDOperatorSymbolGlobVectorDelimiter(v), PDGlobEq(v, '\\'));
+                break;
+            default:
+                hit = PDGlobOr(PDGlobOr(PDGlobEq(v, '\r'), PDGlobEq(v, '\n')), PDGlobEq(v, '\\'));
+                break;
+        }
+#ifdef PD_GLOB_SIMD_X86
+        unsigned mask = PDGlobMask(hit);
+        if (mode == PDGlobSpanWhitespace) mask = ~mask & PD_GLOB_SIMD_FULL;
+        if (mask) return i + __builtin_ctz(mask);
+#else
+        if (mode == PDGlobSpanWhitespace) hit = vmvnq_u8(hit);
+        if (vmaxvq_u8(hit)) break;
+#endif
+    }
+#endif
+    
+    while (i < len && ! PDOperatorSymbolGlobStops(ubuf[i], mode)) i++;
+    return i;
+}
+
+PDSize PDOperatorSymbolGlobSpanWhitespace(const char *buf, PDSize len)
+{
+    return PDOperatorSymbolGlobSpan(buf, len, PDGlobSpanWhitespace);
+}
+
+PDSize PDOperatorSymbolGlobSpanRegular(const char *buf, PDSize len)
+{
+    return PDOperatorSymbolGlobSpan(buf, len, PDGlobSpanRegular);
+}
+
+PDSize PDOperatorSymbolGlobSpanUntilDelimiter(const char *buf, PDSize len)
+{
+    return PDOperatorSymbolGlobSpan(buf, len, PDGlobSpanUntilDelimiter);
+}
+
+PDSize PDOperatorSymbolGlobSpanUntilNewline(const char *buf, PDSize len)
+{
+    return PDOperatorSymbolGlobSpan(buf, len, PDGlobSpanUntilNewline);
+}
+
 void PDOperatorDestroy(PDOperatorRef op)
 {
     switch (op->type) {
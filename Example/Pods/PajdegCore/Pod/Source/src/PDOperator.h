@@ -82,6 +82,52 @@ extern void PDOperatorSymbolGlobSetup();
  */
 extern char PDOperatorSymbolGlobDefine(char *str);
 
+/**
+ Calculate the scanner hash of the given symbol string. The result is identical to the hash the scanner produces when reading the same symbol from a buffer.
+ 
+ @param str The symbol string.
+ @param len The length of the symbol string.
+ */
+extern short PDOperatorSymbolGlobHash(const char *str, PDInteger len);
+
+/**
+ Count the number of leading PDF whitespace characters in the given buffer.
+ 
+ Uses SSE2/AVX2 or NEON to classify 16 or 32 bytes at a time where available, with a scalar fallback.
+ 
+ @param buf The buffer.
+ @param len The number of bytes available in buf.
+ @return The length of the whitespace run starting at buf.
+ */
+extern PDSize PDOperatorSymbolGlobSpanWhitespace(const char *buf, PDSize len);
+
+/**
+ Count the number of leading regular characters in the given buffer, stopping at whitespace, delimiters, and backslashes (which affect the escape state of the following character).
+ 
+ @param buf The buffer.
+ @param len The number of bytes available in buf.
+ @return The length of the regular character run starting at buf.
+ */
+extern PDSize PDOperatorSymbolGlobSpanRegular(const char *buf, PDSize len);
+
+/**
+ Count the number of leading bytes in the given buffer which are neither delimiters nor backslashes.
+ 
+ @param buf The buffer.
+ @param len The number of bytes available in buf.
+ @return The offset of the first delimiter or backslash, or len if there is none.
+ */
+extern PDSize PDOperatorSymbolGlobSpanUntilDelimiter(const char *buf, PDSize len);
+
+/**
+ Count the number of leading bytes in the given buffer which are neither newlines (\\r or \\n) nor backslashes.
+ 
+ @param buf The buffer.
+ @param len The number of bytes available in buf.
+ @return The offset of the first newline or backslash, or len if there is none.
+ */
+extern PDSize PDOperatorSymbolGlobSpanUntilNewline(const char *buf, PDSize len);
+
 /**
  Create a PDOperatorRef chain based on a definition in the form of NULL terminated arrays of operator types followed by (if any) arguments of corresponding types.
  
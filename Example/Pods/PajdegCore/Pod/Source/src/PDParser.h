@@ -52,6 +52,29 @@
  */
 extern PDParserRef PDParserCreateWithStream(PDTwinStreamRef stream);
 
+/**
+ Set up a parser with a twin stream, optionally reconstructing the XREF table if the input's XREF data cannot be read.
+ 
+ @see PDXTableRecoverXRefs
+ 
+ @param stream The stream to use.
+ @param recoverXRefs Whether to reconstruct the XREF table, if necessary. Ignored for incremental updates, as there is no way to append to a PDF whose XREF data is broken.
+ */
+extern PDParserRef PDParserCreateWithStreamAndRecovery(PDTwinStreamRef stream, PDBool recoverXRefs);
+
+/**
+ Set up a parser with a twin stream, optionally reconstructing the XREF table if the input's XREF data cannot be read, and optionally keeping an index of the input in a sidecar file.
+ 
+ If an index path is given and the sidecar at that path matches the input, the XREF tables, trailer, and root/info/encrypt references are taken from the sidecar, and the input's XREF data is not read at all; otherwise, the XREF data is read from the input as usual, and the sidecar is (re)written. The sidecar also holds the object IDs of the document's pages, once the catalog has been set up (see PDParserGetCatalog()), so that subsequent catalogs need not walk the page tree. Index sidecars require a regular input file, and are ignored otherwise. Reconstructed XREF tables are never written to a sidecar.
+ 
+ @see PDXTableFetchSidecar
+ 
+ @param stream The stream to use.
+ @param recoverXRefs Whether to reconstruct the XREF table, if necessary.
+ @param indexPath Path of the index sidecar, or NULL to not use one.
+ */
+extern PDParserRef PDParserCreateWithStreamAndIndex(PDTwinStreamRef stream, PDBool recoverXRefs, const char *indexPath);
+
 /**
  Iterate to the next (living) object.
  
@@ -145,6 +168,54 @@ extern pd_stack PDParserLocateAndCreateDefinitionForObject(PDParserRef parser, P
  */
 extern PDObjectRef PDParserLocateAndCreateObject(PDParserRef parser, PDInteger obid, PDBool master);
 
+/**
+ Set the number of objects kept in the parser's object cache.
+ 
+ Objects fetched via PDParserLocateAndCreateObject are cached per object ID and per XREF (master or current), so that page tree walks, font lookups and the like do not read and parse the same objects repeatedly. When the cache exceeds its capacity, the least recently used objects are evicted. Objects that are still retained by someone other than the cache are never evicted, as they may have been modified, and later lookups must see those modifications. 
+ 
+ The capacity only applies to objects that are not retained elsewhere; objects held by the caller are set aside when they come up for eviction, and stay in the cache on top of the capacity until they are released or looked up again.
+ 
+ The default capacity is 4096 objects. A capacity of 0 means only objects retained elsewhere are kept.
+ 
+ @param parser The parser.
+ @param capacity The max number of (not otherwise retained) objects to keep in the cache.
+ */
+extern void PDParserSetObjectCacheCapacity(PDParserRef parser, PDSize capacity);
+
+/**
+ Get hit, miss and eviction counts for the parser's object cache.
+ 
+ @param parser The parser.
+ @param hits Pointer to the number of lookups that were served from the cache, or NULL.
+ @param misses Pointer to the number of lookups that required reading and parsing the object, or NULL.
+ @param evictions Pointer to the number of objects that have been evicted from the cache, or NULL.
+ */
+extern void PDParserGetObjectCacheStats(PDParserRef parser, PDSize *hits, PDSize *misses, PDSize *evictions);
+
+/**
+ Set the number of object streams kept in the parser's object stream cache.
+ 
+ Looking up an object that is inside an object stream requires decoding the whole object stream and parsing its objects. The parsed object streams are cached per container object ID and per XREF (master or current), so that looking up other objects in the same object stream is a matter of copying a definition. 
+ 
+ As with the object cache, the capacity only applies to object streams that are not retained elsewhere.
+ 
+ The default capacity is 16 object streams. A capacity of 0 disables the cache.
+ 
+ @param parser The parser.
+ @param capacity The max number of object streams to keep in the cache.
+ */
+extern void PDParserSetObjectStreamCacheCapacity(PDParserRef parser, PDSize capacity);
+
+/**
+ Get hit, miss and eviction counts for the parser's object stream cache.
+ 
+ @param parser The parser.
+ @param hits Pointer to the number of compressed object lookups that found their object stream in the cache, or NULL.
+ @param misses Pointer to the number of compressed object lookups that required decoding and parsing the object stream, or NULL.
+ @param evictions Pointer to the number of object streams that have been evicted from the cache, or NULL.
+ */
+extern void PDParserGetObjectStreamCacheStats(PDParserRef parser, PDSize *hits, PDSize *misses, PDSize *evictions);
+
 /**
  Write remaining objects, XREF table, trailer, and end fluff to output PDF.
  
@@ -152,6 +223,20 @@ extern PDObjectRef PDParserLocateAndCreateObject(PDParserRef parser, PDInteger o
  */
 extern void PDParserDone(PDParserRef parser);
 
+/**
+ Pack objects into object streams in the output.
+
+ From here on, dictionary and array objects without streams are not written where they appear, but collected and written into new object streams (PDF 1.5) at the end of the output, and the XREF is written as a compressed stream with minimal field widths, even if the input used an XREF table. Scalar objects are never packed, as they may be the /Length of a stream.
+
+ Packing is not possible in incremental updates, for encrypted input, or if there is no output.
+
+ @note Packing does not change the version in the header of the output; see PDPipeOptionPackObjects.
+
+ @param parser The parser.
+ @return true if packing was enabled, false if it is not possible for this parser.
+ */
+extern PDBool PDParserEnablePacking(PDParserRef parser);
+
 /**
  Determine if object with given id has already been written to output stream (i.e. has become immutable).
  
@@ -180,7 +180,12 @@ void PDParserAttachmentPerformImport(PDParserAttachmentRef attachment, PDObjectR
     
     PDAssert(dest->def == NULL); // crash = the destination is not a new object, or something broke somewhere
     pd_stack def = NULL;
-    PDParserAttachmentImportStack(attachment, &def, source->def, excludeKeys, excludeKeysCount);
+    // objects constructed directly have no definitions stack; we fetch the original definitions rather than generate them from the instance, which would normalize number formatting
+    pd_stack sourceDef = NULL;
+    if (source->def == NULL) 
+        sourceDef = PDParserLocateAndCreateDefinitionForObject(attachment->foreignParser, PDObjectGetObID(source), true);
+    PDParserAttachmentImportStack(attachment, &def, source->def ? source->def : sourceDef, excludeKeys, excludeKeysCount);
+    pd_stack_destroy(&sourceDef);
     dest->def = def;
     PDObjectDetermineType(dest);
     
@@ -22,6 +22,10 @@
 // THE SOFTWARE.
 //
 
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
 #include "Pajdeg.h"
 
 #include "pd_internal.h"
@@ -36,9 +40,166 @@
 #include "PDObjectStream.h"
 #include "PDXTable.h"
 #include "PDString.h"
+#include "PDScanner.h"
+#include "PDOperator.h"
 
 static char *PDFTypeStrings[_PDFTypeCount] = {kPDFTypeStrings};
 
+// /Type names are interned into atoms, the atom of a name being its PDFType, or 0 for names without one; the slot function is collision free for PDFTypeStrings, but should a colliding type ever be added, lookups fall back to a linear search
+#define PD_TYPE_ATOM_SLOTS  32
+
+static unsigned char PDPipeTypeAtoms[PD_TYPE_ATOM_SLOTS];
+static PDInteger PDPipeTypeAtomLengths[_PDFTypeCount];
+static PDBool PDPipeTypeAtomCollisions = false;
+static pthread_once_t PDPipeTypeAtomOnce = PTHREAD_ONCE_INIT;
+
+static inline PDInteger PDPipeTypeAtomSlot(const char *name, PDInteger len)
+{
+    return ((unsigned char)name[1] * 3 + (unsigned char)name[len-1] + len * 5) & (PD_TYPE_ATOM_SLOTS - 1);
+}
+
+static void PDPipeTypeAtomBuild(void)
+{
+    for (int i = 1; i < _PDFTypeCount; i++) {
+        PDInteger len = strlen(PDFTypeStrings[i]);
+        PDInteger slot = PDPipeTypeAtomSlot(PDFTypeStrings[i], len);
+        PDPipeTypeAtomLengths[i] = len;
+        if (PDPipeTypeAtoms[slot]) {
+            PDError("type %s collides with type %s; PDPipeTypeAtomSlot() needs tweaking", PDFTypeStrings[i], PDFTypeStrings[PDPipeTypeAtoms[slot]]);
+            PDPipeTypeAtomCollisions = true;
+            continue;
+        }
+        PDPipeTypeAtoms[slot] = i;
+    }
+}
+
+static inline void PDPipeTypeAtomSetup(void)
+{
+    pthread_once(&PDPipeTypeAtomOnce, PDPipeTypeAtomBuild);
+}
+
+// the atom of the given name, including its leading slash
+static inline PDInteger PDPipeTypeAtom(const char *name, PDInteger len)
+{
+    if (len < 2) return 0;
+    PDInteger atom = PDPipeTypeAtoms[PDPipeTypeAtomSlot(name, len)];
+    if (atom && PDPipeTypeAtomLengths[atom] == len && ! memcmp(PDFTypeStrings[atom], name, len)) return atom;
+    if (PDPipeTypeAtomCollisions) {
+        for (atom = 1; atom < _PDFTypeCount; atom++) 
+            if (PDPipeTypeAtomLengths[atom] == len && ! memcmp(PDFTypeStrings[atom], name, len)) return atom;
+    }
+    return 0;
+}
+
+#define PDPipeGlob(c) PDOperatorSymbolGlob[(unsigned char)(c)]
+
+/**
+ Determine the /Type atom of an object from its raw definition, without constructing it.
+ 
+ Only the top level of the definition is looked at; nested dictionaries, arrays and strings are skipped over, and references are recognized by their keys always being names. 
+ 
+ @return The atom, 0 if the object is not a dictionary or has no /Type with an atom, or -1 if it could not be determined, e.g. because the buffer ended first or the definition is unusual (such as names with # escapes); the object has to be constructed to find out, then.
+ */
+static PDInteger PDPipeSniffTypeAtom(const char *buf, PDInteger len)
+{
+    PDInteger i = 0;
+    PDInteger depth, start, nest;
+    PDBool expectKey = true;
+    PDBool typeKey = false;
+    
+    while (i < len && PDPipeGlob(buf[i]) == PDOperatorSymbolGlobWhitespace) i++;
+    if (i + 1 >= len) return -1;
+    if (buf[i] != '<' || buf[i+1] != '<') return 0;
+    i += 2;
+    depth = 1;
+    
+    for (;;) {
+        while (i < len && PDPipeGlob(buf[i]) == PDOperatorSymbolGlobWhitespace) i++;
+        if (i >= len) return -1;
+        
+        switch (buf[i]) {
+            case '%':
+                while (i < len && buf[i] != '\r' && buf[i] != '\n') i++;
+                continue;
+                
+            case '/':
+                start = i++;
+                while (i < len && PDPipeGlob(buf[i]) == PDOperatorSymbolGlobRegular) i++;
+                if (i >= len) return -1;
+                if (depth > 1) continue;
+                if (expectKey) {
+                    typeKey = i - start == 5 && ! memcmp(&buf[start], "/Type", 5);
+                    expectKey = false;
+                    continue;
+                }
+                if (typeKey) 
+                    return memchr(&buf[start], '#', i - start) ? -1 : PDPipeTypeAtom(&buf[start], i - start);
+                break;
+                
+            case '(':
+                for (nest = 0, i++; i < len; i++) {
+                    if (buf[i] == '\\') i++;
+                    else if (buf[i] == '(') nest++;
+                    else if (buf[i] == ')' && nest-- == 0) break;
+                }
+                if (i++ >= len) return -1;
+                if (depth > 1) continue;
+                if (expectKey || typeKey) return -1;
+                break;
+                
+            case '<':
+                if (i + 1 >= len) return -1;
+                if (buf[i+1] == '<') {
+                    if (depth == 1 && expectKey) return -1;
+                    depth++;
+                    i += 2;
+                    continue;
+                }
+                while (i < len && buf[i] != '>') i++;
+                if (i++ >= len) return -1;
+                if (depth > 1) continue;
+                if (expectKey || typeKey) return -1;
+                break;
+                
+            case '[':
+                if (depth == 1 && expectKey) return -1;
+                depth++;
+                i++;
+                continue;
+                
+            case '>':
+                if (i + 1 >= len || buf[i+1] != '>') return -1;
+                i += 2;
+                // the end of the dictionary itself means there is no /Type
+                if (--depth == 0) return 0;
+                if (depth > 1) continue;
+                break;
+                
+            case ']':
+                i++;
+                if (--depth < 1) return -1;
+                if (depth > 1) continue;
+                break;
+                
+            case ')':
+            case '{':
+            case '}':
+                return -1;
+                
+            default:
+                while (i < len && PDPipeGlob(buf[i]) == PDOperatorSymbolGlobRegular) i++;
+                if (i >= len) return -1;
+                // keys are always names, so anything else in a key position is the rest of a reference value
+                if (depth > 1 || expectKey) continue;
+                break;
+        }
+        
+        // a complete value was passed at the top level
+        if (typeKey) return 0;
+        expectKey = true;
+    }
+}
+
 static int PDPipeFileDescriptorBalance = 0;
 
 void PDPipeCloseFileStream(FILE *stream)
@@ -62,6 +223,97 @@ FILE *PDPipeOpenOutputStream(const char *path)
     return fopen(path, "w+");
 }
 
+#ifdef __APPLE__
+
+// open_memstream() only exists from iOS 11 / OS X 10.13 onward, so on Apple platforms the output buffer is a funopen() stream with the same semantics (minus the flushing: the caller's buffer and length are kept current on every write)
+typedef struct PDPipeMemoryOutput *PDPipeMemoryOutputRef;
+struct PDPipeMemoryOutput {
+    char  **buf;
+    PDSize *len;
+    PDSize  cap;
+    PDSize  pos;
+};
+
+static int PDPipeMemoryOutputWrite(void *cookie, const char *data, int bytes)
+{
+    PDPipeMemoryOutputRef mo = cookie;
+    PDSize end = mo->pos + bytes;
+    
+    // we always keep room for a NUL terminator at the end
+    if (end >= mo->cap) {
+        PDSize cap = mo->cap;
+        while (cap <= end) cap *= 2;
+        char *buf = realloc(*mo->buf, cap);
+        if (NULL == buf) {
+            errno = ENOMEM;
+            return -1;
+        }
+        *mo->buf = buf;
+        mo->cap = cap;
+    }
+    
+    memcpy(*mo->buf + mo->pos, data, bytes);
+    mo->pos = end;
+    if (*mo->len < end) {
+        *mo->len = end;
+        (*mo->buf)[end] = 0;
+    }
+    return bytes;
+}
+
+static fpos_t PDPipeMemoryOutputSeek(void *cookie, fpos_t offset, int whence)
+{
+    PDPipeMemoryOutputRef mo = cookie;
+    fpos_t base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? (fpos_t)mo->pos : (fpos_t)*mo->len;
+    
+    // seeking beyond the end would leave a gap of undefined content, which we don't need
+    if (base + offset < 0 || base + offset > (fpos_t)*mo->len) {
+        errno = EINVAL;
+        return -1;
+    }
+    mo->pos = (PDSize)(base + offset);
+    return base + offset;
+}
+
+static int PDPipeMemoryOutputClose(void *cookie)
+{
+    free(cookie);
+    return 0;
+}
+
+FILE *PDPipeOpenOutputBuffer(char **buf, PDSize *len)
+{
+    PDPipeMemoryOutputRef mo = malloc(sizeof(struct PDPipeMemoryOutput));
+    mo->buf = buf;
+    mo->len = len;
+    mo->cap = 4096;
+    mo->pos = 0;
+    *buf = malloc(mo->cap);
+    **buf = 0;
+    *len = 0;
+    
+    FILE *f = funopen(mo, NULL, PDPipeMemoryOutputWrite, PDPipeMemoryOutputSeek, PDPipeMemoryOutputClose);
+    if (NULL == f) {
+        free(*buf);
+        *buf = NULL;
+        free(mo);
+        return NULL;
+    }
+    
+    PDPipeFileDescriptorBalance++;
+    return f;
+}
+
+#else
+
+FILE *PDPipeOpenOutputBuffer(char **buf, PDSize *len)
+{
+    PDPipeFileDescriptorBalance++;
+    return open_memstream(buf, len);
+}
+
+#endif
+
 //
 //
 //
@@ -71,10 +323,11 @@ void PDPipeDestroy(PDPipeRef pipe)
     PDTaskRef task;
     
     if (pipe->opened) {
-        PDPipeCloseFileStream(pipe->fi);
-        PDPipeCloseFileStream(pipe->fo);
-        PDRelease(pipe->stream);
+        // the stream may have helper threads working on the files, so it goes first
         PDRelease(pipe->parser);
+        PDRelease(pipe->stream);
+        if (pipe->fi) PDPipeCloseFileStream(pipe->fi);
+        if (pipe->fo) PDPipeCloseFileStream(pipe->fo);
     }
     free(pipe->pi);
     free(pipe->po);
@@ -90,33 +343,69 @@ void PDPipeDestroy(PDPipeRef pipe)
 }
 
 PDPipeRef PDPipeCreateWithFilePaths(const char * inputFilePath, const char * outputFilePath)
+{
+    return PDPipeCreateWithFilePathsAndOptions(inputFilePath, outputFilePath, PDPipeOptionsNone);
+}
+
+PDPipeRef PDPipeCreateWithFilePathsAndOptions(const char * inputFilePath, const char * outputFilePath, PDPipeOptions options)
 {
     FILE *fi;
     FILE *fo;
 
     // input must be set
     if (inputFilePath == NULL) return NULL;
-    // we do want to support NULL output for 'readonly mode' but we don't, now; NIX users can pass "/dev/null" to get this behavior
-    if (outputFilePath == NULL) return NULL;
     
-    // files must not be the same
-    if (!strcmp(inputFilePath, outputFilePath)) return NULL;
+    // files must not be the same (a NULL output means readonly mode)
+    if (outputFilePath && !strcmp(inputFilePath, outputFilePath)) return NULL;
     
-    fi = PDPipeOpenInputStream(inputFilePath);
-    if (NULL == fi) {
-        return NULL;
+    // non-seekable inputs (named pipes and such) can only be read once, so they are not test-opened
+    struct stat st;
+    if (stat(inputFilePath, &st)) return NULL;
+    
+    if (S_ISREG(st.st_mode)) {
+        fi = PDPipeOpenInputStream(inputFilePath);
+        if (NULL == fi) {
+            return NULL;
+        }
+        PDPipeCloseFileStream(fi);
     }
-    PDPipeCloseFileStream(fi);
     
-    fo = PDPipeOpenOutputStream(outputFilePath);
-    if (NULL == fo) {
-        return NULL;
+    if (outputFilePath) {
+        fo = PDPipeOpenOutputStream(outputFilePath);
+        if (NULL == fo) {
+            return NULL;
+        }
+        PDPipeCloseFileStream(fo);
     }
-    PDPipeCloseFileStream(fo);
     
     PDPipeRef pipe = PDAllocTyped(PDInstanceTypePipe, sizeof(struct PDPipe), PDPipeDestroy, true);
     pipe->pi = strdup(inputFilePath);
-    pipe->po = strdup(outputFilePath);
+    pipe->po = outputFilePath ? strdup(outputFilePath) : NULL;
+    pipe->options = options;
+    pipe->cacheBudget = PD_TWINSTREAM_DEFAULT_CACHE_BUDGET;
+    pipe->spoolThreshold = PD_TWINSTREAM_DEFAULT_SPOOL_THRESHOLD;
+    pipe->attachments = PDSplayTreeCreateWithDeallocator(PDReleaseFunc);
+    return pipe;
+}
+
+PDPipeRef PDPipeCreateWithBuffers(const char *inputBuffer, PDSize inputLength, char **outputBuffer, PDSize *outputLength)
+{
+    return PDPipeCreateWithBuffersAndOptions(inputBuffer, inputLength, outputBuffer, outputLength, PDPipeOptionsNone);
+}
+
+PDPipeRef PDPipeCreateWithBuffersAndOptions(const char *inputBuffer, PDSize inputLength, char **outputBuffer, PDSize *outputLength, PDPipeOptions options)
+{
+    if (inputBuffer == NULL || inputLength == 0) return NULL;
+    // a NULL output buffer means readonly mode, but both or neither must be given
+    if ((outputBuffer == NULL) != (outputLength == NULL)) return NULL;
+    
+    PDPipeRef pipe = PDAllocTyped(PDInstanceTypePipe, sizeof(struct PDPipe), PDPipeDestroy, true);
+    pipe->ibuf = inputBuffer;
+    pipe->ilen = inputLength;
+    pipe->obuf = outputBuffer;
+    pipe->olen = outputLength;
+    pipe->options = options;
+    pipe->cacheBudget = PD_TWINSTREAM_DEFAULT_CACHE_BUDGET;
     pipe->attachments = PDSplayTreeCreateWithDeallocator(PDReleaseFunc);
     return pipe;
 }
@@ -189,6 +478,7 @@ void PDPipeAddTask(PDPipeRef pipe, PDTaskRef task)
             case PDPropertyPDFType:
                 pipe->typedTasks = true;
                 PDAssert(task->value > 0 && task->value < _PDFTypeCount); // crash = value out of range; must be set to a PDFType!
+                PDPipeTypeAtomSetup();
                 
                 // task executes on every object of the given type
                 pd_stack_push_identifier(&pipe->typeTasks[task->value], (PDID)PDRetain(task->child));
@@ -256,29 +546,102 @@ PDObjectRef PDPipeGetRootObject(PDPipeRef pipe)
     return PDParserGetRootObject(pipe->parser);
 }
 
+// the version in the input's header, as major * 10 + minor, or 0 if there is no recognizable header
+static PDInteger PDPipeGetHeaderVersion(PDPipeRef pipe)
+{
+    char buf[16];
+    PDSize got = PDTwinStreamReadRange(pipe->stream, 0, sizeof(buf), buf);
+    if (got < 8 || strncmp(buf, "%PDF-", 5) || buf[5] < '0' || buf[5] > '9' || buf[6] != '.' || buf[7] < '0' || buf[7] > '9') 
+        return 0;
+    return (buf[5] - '0') * 10 + buf[7] - '0';
+}
+
+// object and XREF streams were introduced in PDF 1.5; the catalog's /Version overrides an older version in the header, which is passed through as is
+static PDTaskResult PDPipeDeclarePackingVersion(PDPipeRef pipe, PDTaskRef task, PDObjectRef object, void *info)
+{
+    PDDictionaryRef root = PDObjectGetDictionary(object);
+    if (root == NULL) return PDTaskUnload;
+    
+    PDStringRef version = PDDictionaryGetString(root, "Version");
+    if (version == NULL || strcmp(PDStringNameValue(version, false), "/1.5") < 0) {
+        PDDictionarySet(root, "Version", PDStringWithName(strdup("/1.5")));
+    }
+    
+    return PDTaskUnload;
+}
+
 PDBool PDPipePrepare(PDPipeRef pipe)
 {
     if (pipe->opened) {
         return true;
     }
     
-    pipe->fi = PDPipeOpenInputStream(pipe->pi);
-    if (NULL == pipe->fi) {
-        PDNotice("unable to open input stream for path: %s", pipe->pi);
-        return false;
+    if (pipe->ibuf) {
+        pipe->fo = pipe->obuf ? PDPipeOpenOutputBuffer(pipe->obuf, pipe->olen) : NULL;
+        if (pipe->obuf && NULL == pipe->fo) {
+            PDNotice("unable to open output buffer stream");
+            return false;
+        }
+        
+        pipe->opened = true;
+        
+        pipe->stream = PDTwinStreamCreateWithBuffer(pipe->ibuf, pipe->ilen, pipe->fo);
+    } else {
+        pipe->fi = PDPipeOpenInputStream(pipe->pi);
+        if (NULL == pipe->fi) {
+            PDNotice("unable to open input stream for path: %s", pipe->pi);
+            return false;
+        }
+        pipe->fo = pipe->po ? PDPipeOpenOutputStream(pipe->po) : NULL;
+        if (pipe->po && NULL == pipe->fo) {
+            PDNotice("unable to open output stream for path: %s", pipe->po);
+            PDPipeCloseFileStream(pipe->fi);
+            pipe->fi = NULL;
+            return false;
+        }
+        
+        pipe->opened = true;
+        
+        struct stat st;
+        if (0 == fstat(fileno(pipe->fi), &st) && ! S_ISREG(st.st_mode)) {
+            PDSize threshold = pipe->memoryCeiling && pipe->memoryCeiling < pipe->spoolThreshold ? pipe->memoryCeiling : pipe->spoolThreshold;
+            pipe->stream = PDTwinStreamCreateWithSpooledInput(pipe->fi, pipe->fo, threshold);
+            if (NULL == pipe->stream) {
+                PDNotice("unable to spool non-seekable input %s", pipe->pi);
+                return false;
+            }
+        } else {
+            pipe->stream = PDTwinStreamCreate(pipe->fi, pipe->fo);
+        }
+        PDTwinStreamSetBranchCacheBudget(pipe->stream, pipe->cacheBudget);
+        if ((pipe->options & PDPipeOptionMemoryMappedInput) && ! PDTwinStreamMapInput(pipe->stream)) {
+            PDNotice("unable to memory map input file %s; falling back to regular reads", pipe->pi);
+        }
+    }
+    
+    PDTwinStreamSetMemoryCeiling(pipe->stream, pipe->memoryCeiling);
+    
+    if ((pipe->options & PDPipeOptionIncrementalUpdate) && pipe->fo) {
+        PDTwinStreamBeginIncrementalUpdate(pipe->stream);
+    }
+    
+    // buffers are in memory from the get go, and can't be written to behind the pipe's back
+    if ((pipe->options & PDPipeOptionReadAhead) && pipe->fi && ! PDTwinStreamEnableReadAhead(pipe->stream)) {
+        PDNotice("not reading ahead for input %s", pipe->pi);
     }
-    pipe->fo = PDPipeOpenOutputStream(pipe->po);
-    if (NULL == pipe->fo) {
-        PDNotice("unable to open output stream for path: %s", pipe->po);
-        PDPipeCloseFileStream(pipe->fi);
-        pipe->fi = NULL;
-        return false;
+    
+    if ((pipe->options & PDPipeOptionWriteBehind) && pipe->po && ! PDTwinStreamEnableWriteBehind(pipe->stream)) {
+        PDNotice("not writing behind for output %s", pipe->po);
     }
     
-    pipe->opened = true;
+    char *indexPath = NULL;
+    if ((pipe->options & PDPipeOptionIndexSidecar) && pipe->pi) {
+        indexPath = malloc(strlen(pipe->pi) + 7);
+        sprintf(indexPath, "%s.pdidx", pipe->pi);
+    }
     
-    pipe->stream = PDTwinStreamCreate(pipe->fi, pipe->fo);
-    pipe->parser = PDParserCreateWithStream(pipe->stream);
+    pipe->parser = PDParserCreateWithStreamAndIndex(pipe->stream, 0 != (pipe->options & PDPipeOptionRecoverXRefs), indexPath);
+    free(indexPath);
     
     if (pipe->parser) {
 #ifdef PD_SUPPORT_CRYPTO
@@ -292,6 +655,16 @@ PDBool PDPipePrepare(PDPipeRef pipe)
 #endif
             
         pipe->filter = PDSplayTreeCreateWithDeallocator(PDReleaseFunc);
+        
+        if (pipe->options & PDPipeOptionPackObjects) {
+            if (! PDParserEnablePacking(pipe->parser)) {
+                PDNotice("not packing objects for input %s", pipe->pi ? pipe->pi : "buffer");
+            } else if (PDPipeGetHeaderVersion(pipe) < 15) {
+                PDTaskRef task = PDTaskCreateMutatorForPropertyType(PDPropertyRootObject, PDPipeDeclarePackingVersion);
+                PDPipeAddTask(pipe, task);
+                PDRelease(task);
+            }
+        }
     }
 
     return pipe->stream && pipe->parser;
@@ -329,6 +702,31 @@ static inline PDBool PDPipeRunStackedTasks(PDPipeRef pipe, PDParserRef parser, p
     return true;
 }
 
+// the /Type atom of the parser's current object, which is sniffed from its definition, unless it has been constructed already
+static inline PDInteger PDPipeGetTypeAtom(PDParserRef parser)
+{
+    const char *buf;
+    PDInteger len;
+    PDInteger atom = -1;
+    
+    if (parser->construct == NULL && parser->state == PDParserStateObjectDefinition && PDScannerGetUnscannedBuffer(parser->scanner, &buf, &len)) 
+        atom = PDPipeSniffTypeAtom(buf, len);
+    
+    if (atom == -1) {
+        PDObjectRef obj = PDParserConstructObject(parser);
+        atom = 0;
+        if (PDObjectTypeDictionary == PDObjectGetType(obj)) {
+            PDStringRef pt = PDDictionaryGet(PDObjectGetDictionary(obj), "Type");
+            if (pt && PDResolve(pt) == PDInstanceTypeString) {
+                const char *name = PDStringNameValue(pt, false);
+                atom = PDPipeTypeAtom(name, strlen(name));
+            }
+        }
+    }
+    
+    return atom;
+}
+
 PDInteger PDPipeExecute(PDPipeRef pipe)
 {
     // if pipe is closed, we need to prepare
@@ -338,9 +736,7 @@ PDInteger PDPipeExecute(PDPipeRef pipe)
     PDStaticHashRef sht = NULL;
     PDParserRef parser = pipe->parser;
     PDTaskRef task;
-    PDObjectRef obj;
-    PDStringRef pt;
-    int pti;
+    PDInteger pti;
     
     // at this point, we set up a static hash table for O(1) filtering before the O(n) tree fetch; the SHT implementation here triggers false positives and cannot be used on its own
     pipe->dynamicFiltering = pipe->typedTasks;
@@ -375,22 +771,11 @@ PDInteger PDPipeExecute(PDPipeRef pipe)
                 //printf("* task: object #%lu @ offset %lld *\n", parser->obid, PDTwinStreamGetInputOffset(parser->stream));
                 if (! (proceed &= PDTaskFailure != PDTaskExec(task, pipe, PDParserConstructObject(parser)))) break;
             
-            // by type
+            // by type; the object is only constructed if a type task applies to it, or if its type can't be sniffed
             if (proceed && pipe->typedTasks) {
-                // @todo this really needs to be streamlined; for starters, a PDState object could be used to set up types instead of O(n)'ing
-                obj = PDParserConstructObject(parser);
-                if (PDObjectTypeDictionary == PDObjectGetType(obj)) {
-                    pt = PDDictionaryGet(PDObjectGetDictionary(obj), "Type");
-                    if (pt) {
-                        //printf("pt = %s\n", pt);
-                        for (pti = 1; pti < _PDFTypeCount; pti++) // not = 0, because 0 = NULL and is reserved for 'unfiltered'
-                            if (PDStringEqualsCString(pt, PDFTypeStrings[pti]))
-                                break;
-                        
-                        if (pti < _PDFTypeCount) 
-                            proceed &= PDPipeRunStackedTasks(pipe, parser, &pipe->typeTasks[pti]);
-                    }
-                }
+                pti = PDPipeGetTypeAtom(parser);
+                if (pti > 0 && pipe->typeTasks[pti]) 
+                    proceed &= PDPipeRunStackedTasks(pipe, parser, &pipe->typeTasks[pti]);
             }
 
         } else { 
@@ -409,6 +794,8 @@ PDInteger PDPipeExecute(PDPipeRef pipe)
     if (proceed) 
         PDParserDone(parser);
     
+    PDTwinStreamGetStats(pipe->stream, &pipe->stats);
+    
     PDRelease(pipe->filter);
     PDRelease(parser);
     PDRelease(pipe->stream);
@@ -417,13 +804,53 @@ PDInteger PDPipeExecute(PDPipeRef pipe)
     pipe->parser = NULL;
     pipe->stream = NULL;
     
-    PDPipeCloseFileStream(pipe->fi);
-    PDPipeCloseFileStream(pipe->fo);
+    if (pipe->fi) PDPipeCloseFileStream(pipe->fi);
+    if (pipe->fo) PDPipeCloseFileStream(pipe->fo);
+    pipe->fi = pipe->fo = NULL;
     pipe->opened = false;
     
     return proceed ? seen : -1;
 }
 
+void PDPipeSetBranchCacheBudget(PDPipeRef pipe, PDSize bytes)
+{
+    pipe->cacheBudget = bytes;
+    if (pipe->stream) 
+        PDTwinStreamSetBranchCacheBudget(pipe->stream, bytes);
+}
+
+void PDPipeSetSpoolThreshold(PDPipeRef pipe, PDSize bytes)
+{
+    pipe->spoolThreshold = bytes;
+}
+
+void PDPipeSetMemoryCeiling(PDPipeRef pipe, PDSize bytes)
+{
+    pipe->memoryCeiling = bytes;
+    if (pipe->stream) 
+        PDTwinStreamSetMemoryCeiling(pipe->stream, bytes);
+}
+
+void PDPipeGetBranchCacheCounters(PDPipeRef pipe, PDSize *hits, PDSize *misses, PDSize *evictions)
+{
+    if (pipe->stream) {
+        PDTwinStreamGetBranchCacheCounters(pipe->stream, hits, misses, evictions);
+        return;
+    }
+    if (hits) *hits = 0;
+    if (misses) *misses = 0;
+    if (evictions) *evictions = 0;
+}
+
+void PDPipeGetStats(PDPipeRef pipe, PDIOStats *stats)
+{
+    if (pipe->stream) {
+        PDTwinStreamGetStats(pipe->stream, stats);
+        return;
+    }
+    *stats = pipe->stats;
+}
+
 const char *PDPipeGetInputFilePath(PDPipeRef pipe)
 {
     return pipe->pi;
@@ -83,12 +83,55 @@
 /**
  Create a pipe with an input PDF file and an output PDF file.
  
- @param inputFilePath   The input PDF file (must be readable and exist).
- @param outputFilePath  The output PDF file (must be readwritable). If the file exists, it is overwritten. The file may not be the same as inputFilePath. On most operating systems, "/dev/null" can be passed to provide a readonly session (not MS Windows), but this must be explicitly passed, and NULL will result in failure.
+ @param inputFilePath   The input PDF file (must be readable and exist). This may also be a non-seekable file, such as a named pipe or /dev/stdin; in that case, the input is read in its entirety when the pipe is prepared, and kept in memory or, past the spool threshold, in a temporary file (see PDPipeSetSpoolThreshold()).
+ @param outputFilePath  The output PDF file (must be readwritable). If the file exists, it is overwritten. The file may not be the same as inputFilePath. If NULL, the pipe is readonly: tasks are run as usual, but nothing is written anywhere, and no XREF table or trailer is generated.
  @return The PDPipeRef instance, or NULL if the pipe cannot be set up.
  */
 extern PDPipeRef PDPipeCreateWithFilePaths(const char * inputFilePath, const char * outputFilePath);
 
+/**
+ Create a pipe with an input PDF file, an output PDF file, and the given options.
+ 
+ @param inputFilePath   The input PDF file (must be readable and exist).
+ @param outputFilePath  The output PDF file. See PDPipeCreateWithFilePaths().
+ @param options         The pipe options, OR'd together.
+ @return The PDPipeRef instance, or NULL if the pipe cannot be set up.
+ 
+ @see PDPipeOptions
+ */
+extern PDPipeRef PDPipeCreateWithFilePathsAndOptions(const char * inputFilePath, const char * outputFilePath, PDPipeOptions options);
+
+/**
+ Create a pipe with an input PDF in memory and an output PDF written to memory.
+ 
+ The output buffer is managed like that of open_memstream(3): *outputBuffer and *outputLength are updated as output is written, and are final once PDPipeExecute() returns. The caller must free() *outputBuffer when done with it, even if execution failed.
+ 
+ @param inputBuffer     The input PDF. The buffer is owned by the caller, and must remain valid and unmodified until the pipe is prepared (see PDPipePrepare()), after which the pipe works on a copy of it.
+ @param inputLength     The length of the input PDF in bytes.
+ @param outputBuffer    Pointer to the output buffer, or NULL for a readonly pipe.
+ @param outputLength    Pointer to the output length, or NULL for a readonly pipe.
+ @return The PDPipeRef instance, or NULL if the pipe cannot be set up.
+ 
+ @note PDPipeGetInputFilePath() and PDPipeGetOutputFilePath() return NULL for pipes created with buffers.
+ */
+extern PDPipeRef PDPipeCreateWithBuffers(const char *inputBuffer, PDSize inputLength, char **outputBuffer, PDSize *outputLength);
+
+/**
+ Create a pipe with an input PDF in memory, an output PDF written to memory, and the given options.
+ 
+ Options that only make sense for files (PDPipeOptionMemoryMappedInput, PDPipeOptionReadAhead, PDPipeOptionWriteBehind and PDPipeOptionIndexSidecar) are ignored.
+ 
+ @param inputBuffer     The input PDF. See PDPipeCreateWithBuffers().
+ @param inputLength     The length of the input PDF in bytes.
+ @param outputBuffer    Pointer to the output buffer, or NULL for a readonly pipe.
+ @param outputLength    Pointer to the output length, or NULL for a readonly pipe.
+ @param options         The pipe options, OR'd together.
+ @return The PDPipeRef instance, or NULL if the pipe cannot be set up.
+ 
+ @see PDPipeOptions
+ */
+extern PDPipeRef PDPipeCreateWithBuffersAndOptions(const char *inputBuffer, PDSize inputLength, char **outputBuffer, PDSize *outputLength, PDPipeOptions options);
+
 /**
  Attach a task to a pipe. 
  
@@ -139,11 +182,63 @@ extern PDObjectRef PDPipeGetRootObject(PDPipeRef pipe);
  */
 extern PDInteger PDPipeExecute(PDPipeRef pipe);
 
+/**
+ Set the byte budget of the block cache used when objects are fetched out of order (e.g. when walking the page tree or resolving references before the stream reaches them).
+ 
+ @param pipe The pipe.
+ @param bytes The budget in bytes; 0 disables the cache. The default is PD_TWINSTREAM_DEFAULT_CACHE_BUDGET.
+ */
+extern void PDPipeSetBranchCacheBudget(PDPipeRef pipe, PDSize bytes);
+
+/**
+ Set the number of bytes of non-seekable input (e.g. a named pipe) that may be held in memory. Larger inputs are spilled to a temporary file.
+ 
+ @note Has no effect once the pipe has been prepared.
+ 
+ @param pipe The pipe.
+ @param bytes The threshold in bytes. The default is PD_TWINSTREAM_DEFAULT_SPOOL_THRESHOLD.
+ */
+extern void PDPipeSetSpoolThreshold(PDPipeRef pipe, PDSize bytes);
+
+/**
+ Set the memory ceiling of the pipe. 
+ 
+ With a ceiling, requested stream content (e.g. via PDObjectGetStream()) is read straight off of the input, and raw or decoded content larger than the ceiling goes into memory mapped temporary files rather than onto the heap. Unless such a stream is replaced, its original content is passed through to the output as is, rather than re-encoded. Passed through content is always copied in chunks, regardless of ceiling. The ceiling also caps the spool threshold (see PDPipeSetSpoolThreshold()), and the stream heap is shrunk back down if it ever grows beyond it.
+ 
+ @note The spool threshold cap has no effect once the pipe has been prepared.
+ 
+ @param pipe The pipe.
+ @param bytes The ceiling in bytes. The default is 0, which means there is no ceiling.
+ */
+extern void PDPipeSetMemoryCeiling(PDPipeRef pipe, PDSize bytes);
+
+/**
+ Get the block cache counters of the pipe.
+ 
+ @note Counters are only available while the pipe is prepared, i.e. up until PDPipeExecute() returns; all counters are 0 at other times.
+ 
+ @param pipe The pipe.
+ @param hits Pointer to the number of blocks served from the cache, or NULL.
+ @param misses Pointer to the number of blocks read from input, or NULL.
+ @param evictions Pointer to the number of blocks evicted, or NULL.
+ */
+extern void PDPipeGetBranchCacheCounters(PDPipeRef pipe, PDSize *hits, PDSize *misses, PDSize *evictions);
+
+/**
+ Get the I/O statistics of the pipe.
+ 
+ While the pipe is prepared, the statistics so far are given. Once PDPipeExecute() returns, the statistics of the finished execution remain available until the pipe is prepared and executed again. All counters are 0 before the pipe is first executed.
+ 
+ @param pipe The pipe.
+ @param stats Pointer to the statistics struct to fill in.
+ */
+extern void PDPipeGetStats(PDPipeRef pipe, PDIOStats *stats);
+
 /**
  Get pipe input file path.
  
  @param pipe The pipe.
- @return The input file path, as provided when the pipe was created.
+ @return The input file path, as provided when the pipe was created, or NULL if the pipe was created with buffers.
  */
 extern const char *PDPipeGetInputFilePath(PDPipeRef pipe);
 
@@ -151,7 +246,7 @@ extern const char *PDPipeGetInputFilePath(PDPipeRef pipe);
  Get pipe output file path.
  
  @param pipe The pipe.
- @return The output file path, as provided when the pipe was created.
+ @return The output file path, as provided when the pipe was created, or NULL if the pipe was created with buffers or is readonly.
  */
 extern const char *PDPipeGetOutputFilePath(PDPipeRef pipe);
 
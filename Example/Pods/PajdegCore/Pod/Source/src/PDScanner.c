@@ -54,6 +54,37 @@ void PDScannerPopContext(PDScannerRef scanner)
     scanner->bufFunc = (PDScannerBufFunc)pd_stack_pop_identifier(&scanner->contextStack);
 }
 
+/**
+ Push a copy of sym onto the symbols stack. 
+ 
+ If a checkpoint is active and the push overwrites an entry that existed when the checkpoint was made, the entries that are now at risk are copied into the backup first, so that a rollback only has to restore what was actually overwritten.
+ */
+static inline void PDScannerPushSymbolStack(PDScannerRef scanner, PDScannerSymbolRef sym)
+{
+    PDInteger i = scanner->symbols;
+    if (i == scanner->symbolsCap) {
+        scanner->symbolsCap = scanner->symbolsCap ? scanner->symbolsCap << 1 : 4;
+        scanner->symbolStack = realloc(scanner->symbolStack, sizeof(struct PDScannerSymbol) * scanner->symbolsCap);
+        scanner->symbolBackup = realloc(scanner->symbolBackup, sizeof(struct PDScannerSymbol) * scanner->symbolsCap);
+    }
+    if (i < scanner->symbolsSaved) {
+        memcpy(&scanner->symbolBackup[i], &scanner->symbolStack[i], sizeof(struct PDScannerSymbol) * (scanner->symbolsSaved - i));
+        scanner->symbolsSaved = i;
+    }
+    scanner->symbolStack[i] = *sym;
+    scanner->symbols = i + 1;
+}
+
+/**
+ Pop the top symbol off of the symbols stack into the scanner's current symbol.
+ */
+static inline void PDScannerPopSymbolStack(PDScannerRef scanner)
+{
+    if (NULL == scanner->sym) 
+        scanner->sym = malloc(sizeof(struct PDScannerSymbol));
+    *scanner->sym = scanner->symbolStack[--scanner->symbols];
+}
+
 void PDScannerSetLoopCap(PDInteger cap)
 {
     PDScannerScanAttemptCap = cap;
@@ -96,11 +127,12 @@ void PDScannerDestroy(PDScannerRef scanner)
     }
     
     pd_stack_destroy(&scanner->resultStack);
-    pd_stack_destroy(&scanner->symbolStack);
     pd_stack_destroy(&scanner->garbageStack);
     pd_stack_destroy(&scanner->contextStack);
     
     free(scanner->sym);
+    free(scanner->symbolStack);
+    free(scanner->symbolBackup);
 }
 
 PDScannerRef PDScannerCreateWithStateAndPopFunc(PDStateRef state, PDScannerPopFunc popFunc)
@@ -128,7 +160,7 @@ void PDScannerAttachFixedSizeBuffer(PDScannerRef scanner, char *buf, PDInteger l
 
 void PDScannerAlign(PDScannerRef scanner, PDOffset offset)
 {
-    pd_stack s;
+    PDInteger i, n;
     PDScannerSymbolRef sym;
     
     scanner->buf += offset;
@@ -136,8 +168,15 @@ void PDScannerAlign(PDScannerRef scanner, PDOffset offset)
     // can most likely skip fake checks entirely as it only happens during a scan, not after, but what if a fake symbol is the final symbol in the list after scan? hm
     sym = scanner->sym;
     if (sym && (sym->stype ^ PDScannerSymbolTypeFake)) sym->sstart += offset;
-    for (s = scanner->symbolStack; s; s = s->prev) {
-        sym = s->info;
+    // popped entries below the checkpoint depth may be brought back by a rollback, so they are kept aligned as well
+    n = scanner->symbols > scanner->symbolsCheckpoint ? scanner->symbols : scanner->symbolsCheckpoint;
+    for (i = 0; i < n; i++) {
+        sym = &scanner->symbolStack[i];
+        if (sym->stype ^ PDScannerSymbolTypeFake)
+            sym->sstart += offset;
+    }
+    for (i = scanner->symbolsSaved; i < scanner->symbolsCheckpoint; i++) {
+        sym = &scanner->symbolBackup[i];
         if (sym->stype ^ PDScannerSymbolTypeFake)
             sym->sstart += offset;
     }
@@ -162,7 +201,7 @@ void PDScannerReset(PDScannerRef scanner)
     scanner->boffset = scanner->bsize = 0;
     // scanner->btrail = 0;
     scanner->buf = NULL;
-    pd_stack_destroy(&scanner->symbolStack);
+    scanner->symbols = 0;
     pd_stack_destroy(&scanner->resultStack);
 }
 
@@ -215,10 +254,9 @@ PDInteger PDScannerPassSymbolCharacterType(PDScannerRef scanner, PDInteger symbo
 
 void PDScannerPopSymbol(PDScannerRef scanner)
 {
-    if (scanner->symbolStack) {
+    if (scanner->symbols) {
         // a symbol on stack is ready for use, so we use that
-        if (scanner->sym) free(scanner->sym);
-        scanner->sym = pd_stack_pop_freeable(&scanner->symbolStack);
+        PDScannerPopSymbolStack(scanner);
         return;
     }
     
@@ -258,6 +296,11 @@ void PDScannerPopSymbol(PDScannerRef scanner)
             if (bsize <= i) 
                 break;
         }
+        if (len == 0 && type == PDScannerSymbolTypeWhitespace) {
+            // leading whitespace does not affect the symbol, so we skip it a block at a time
+            i += PDOperatorSymbolGlobSpanWhitespace(&buf[i], bsize - i);
+            if (bsize <= i) continue;
+        }
         prevtype = type;
         c = buf[i];
         type = escaped ? PDScannerSymbolTypeDefault : PDOperatorSymbolGlob[c];
@@ -276,6 +319,20 @@ void PDScannerPopSymbol(PDScannerRef scanner)
             }
         } else break;
         i++;
+        
+        if (type == PDScannerSymbolTypeDefault && ! escaped && i < bsize) {
+            // inside a regular symbol, the rest of the run up to the next whitespace, delimiter or backslash is accepted as is; we still need hash and numeric for each character
+            I = i + PDOperatorSymbolGlobSpanRegular(&buf[i], bsize - i);
+            if (I > i) {
+                prevtype = PDScannerSymbolTypeDefault;
+                for (; i < I; i++) {
+                    c = buf[i];
+                    len ++;
+                    hash += c;
+                    PDSymbolUpdateNumeric(numeric, real, c, false);
+                }
+            }
+        }
     }
     
     // we also want to bump offset past whitespace, but we limit newline consumption to nothing, \n, \r, or \r\n
@@ -319,10 +376,9 @@ void PDScannerPopSymbol(PDScannerRef scanner)
 
 void PDScannerPopSymbolRev(PDScannerRef scanner)
 {
-    if (scanner->symbolStack) {
+    if (scanner->symbols) {
         // a symbol on stack is ready for use, so we use that
-        if (scanner->sym) free(scanner->sym);
-        scanner->sym = pd_stack_pop_freeable(&scanner->symbolStack);
+        PDScannerPopSymbolStack(scanner);
         return;
     }
     
@@ -394,12 +450,14 @@ void PDScannerReadUntilDelimiter(PDScannerRef scanner, PDBool delimiterIsNewline
     
     // if we have a symbol stack we want to pop it all and rewind back to where it was, or we may end up skipping content; we do not reset 'i' (the cursor) however, or we may end up looping infinitely; if this is a newline delimiter operation, however, we do need to reset 'i' as well, or we may end up trampling past the newline character for cases where the line to be skipped is a single symbol (e.g. "PDF-1.4"); in these cases, we also rewind beyond 'sym', and not just beyond symbol stack content
     
-    if ((delimiterIsNewline && sym) || scanner->symbolStack) {
-        while (scanner->symbolStack) {
-            if (sym) free(sym);
-            sym = pd_stack_pop_freeable(&scanner->symbolStack);
+    if ((delimiterIsNewline && sym) || scanner->symbols) {
+        if (scanner->symbols) {
+            // the bottom of the stack is where the symbol stack began
+            if (NULL == sym) 
+                scanner->sym = sym = malloc(sizeof(struct PDScannerSymbol));
+            *sym = scanner->symbolStack[0];
+            scanner->symbols = 0;
         }
-        scanner->sym = sym;
         scanner->boffset = sym->sstart - scanner->buf;
         if (delimiterIsNewline) i = scanner->boffset;
     }
@@ -414,6 +472,12 @@ void PDScannerReadUntilDelimiter(PDScannerRef scanner, PDBool delimiterIsNewline
             if (bsize <= i)
                 break;
         }
+        if (! escaped) {
+            i += (delimiterIsNewline
+                  ? PDOperatorSymbolGlobSpanUntilNewline(&buf[i], bsize - i)
+                  : PDOperatorSymbolGlobSpanUntilDelimiter(&buf[i], bsize - i));
+            if (bsize <= i) continue;
+        }
         if (! escaped && 
             ((delimiterIsNewline && (buf[i] == '\n' || buf[i] == '\r')) ||
              (!delimiterIsNewline && PDOperatorSymbolGlob[(unsigned char)buf[i]] == PDOperatorSymbolGlobDelimiter)))
@@ -559,14 +623,14 @@ void PDScannerOperate(PDScannerRef scanner, PDOperatorRef op)
                     // todo: verify that this doesn't break by-ref stringing
                 }
                 sym->slen = strlen(sym->sstart);
+                sym->shash = PDOperatorSymbolGlobHash(sym->sstart, sym->slen);
                 sym->stype = PDScannerSymbolTypeFake | PDOperatorSymbolGlobDefine(sym->sstart);
                 
                 // fall through to pushback symbol that we just created
                 
             case PDOperatorPushbackSymbol:  // rewind scanner, in a sense, so that we read this symbol again the next scan
                 PDAssert(sym);
-                pd_stack_push_freeable(&scanner->symbolStack, sym);
-                scanner->sym = NULL;
+                PDScannerPushSymbolStack(scanner, sym);
                 break;
                 
             case PDOperatorStoveComplex:    // add ["type", <variable stack>] to build stack; varStack is reset
@@ -635,28 +699,21 @@ void PDScannerScan(PDScannerRef scanner)
     PDStateRef state;
     PDScannerSymbolRef sym;
     PDOperatorRef op;
-    char **symbol;
-    short symindices;
-    short hash;
-    PDInteger *symindex;
+    PDInteger symi;
     PDInteger bresoffset = scanner->boffset;
     env = scanner->env;
     state = env->state;
     do {
-        symindices = state->symindices;
-        symbol = state->symbol;
-        symindex = state->symindex;
-        
         scanner->popFunc(scanner);
         sym = scanner->sym;
         op = NULL;
         if (sym->slen > 0) {
-            hash = sym->shash & (symindices-1);
-            //   |hash entry exists   |hash is not missing   |symbol does not match hash entry
-            while (hash < symindices && symindex[hash] != 0 && strncmp(symbol[symindex[hash]-1], sym->sstart, sym->slen)) 
-                hash++;
-            op = (hash < symindices && symindex[hash]
-                  ? state->symbolOp[symindex[hash]-1]
+            // the state's hash is perfect, so the slot either holds this symbol or nothing at all
+            symi = state->symindex[PDStateSymbolSlot(state, sym->shash, sym->sstart[0])] - 1;
+            if (symi >= 0 && (state->symlen[symi] != sym->slen || memcmp(state->symbol[symi], sym->sstart, sym->slen)))
+                symi = -1;
+            op = (symi >= 0
+                  ? state->symbolOp[symi]
                   : (sym->stype & PDOperatorSymbolExtNumeric) && state->numberOp
                   ? state->numberOp
                   : (sym->stype & PDOperatorSymbolGlobDelimiter) && state->delimiterOp
@@ -704,25 +761,22 @@ PDBool PDScannerPollType(PDScannerRef scanner, char type)
 {
     if (scanner->failed) return false;
     
-    if (scanner->symbolStack == NULL) {
+    if (scanner->symbols == 0) {
         pd_stack_destroy(&scanner->garbageStack);
     }
     
     PDInteger boffs_copy = scanner->boffset;
-    pd_stack ss_copy = NULL;
     
     if (! scanner->strict) {
-        ss_copy = NULL;
-        for (pd_stack s = scanner->symbolStack; s; s = s->prev) {
-            PDScannerSymbolRef sym = malloc(sizeof(struct PDScannerSymbol));
-            memcpy(sym, s->info, sizeof(struct PDScannerSymbol));
-            pd_stack_push_freeable(&ss_copy, sym);
-        }
+        // checkpoint the symbol stack; entries are only copied if they are about to be overwritten (see PDScannerPushSymbolStack)
+        scanner->symbolsCheckpoint = scanner->symbolsSaved = scanner->symbols;
     }
     
     while (!scanner->failed && scanner->env && !scanner->resultStack) {
-        if (PDScannerScanAttemptCap > -1 && PDScannerScanAttemptCap-- == 0) 
+        if (PDScannerScanAttemptCap > -1 && PDScannerScanAttemptCap-- == 0) {
+            scanner->symbolsCheckpoint = scanner->symbolsSaved = 0;
             return false;
+        }
         PDScannerScan(scanner);
     }
     
@@ -733,11 +787,12 @@ PDBool PDScannerPollType(PDScannerRef scanner, char type)
                 free(scanner->sym);
             }
             scanner->sym = NULL;
-            pd_stack_destroy(&scanner->symbolStack);
-            while (ss_copy) pd_stack_pop_into(&scanner->symbolStack, &ss_copy);
-        } else {
-            if (ss_copy) pd_stack_destroy(&ss_copy);
+            // roll back: entries untouched since the checkpoint are still in place, and overwritten ones are in the backup
+            if (scanner->symbolsSaved < scanner->symbolsCheckpoint)
+                memcpy(&scanner->symbolStack[scanner->symbolsSaved], &scanner->symbolBackup[scanner->symbolsSaved], sizeof(struct PDScannerSymbol) * (scanner->symbolsCheckpoint - scanner->symbolsSaved));
+            scanner->symbols = scanner->symbolsCheckpoint;
         }
+        scanner->symbolsCheckpoint = scanner->symbolsSaved = 0;
     }
     
     PDScannerScanAttemptCap = -1;
@@ -763,6 +818,44 @@ PDBool PDScannerPopStack(PDScannerRef scanner, pd_stack *value)
     return false;
 }
 
+// whether the scanner is idle at its root state, i.e. nothing has been scanned ahead
+static inline PDBool PDScannerIsIdle(PDScannerRef scanner)
+{
+    return ! (scanner->failed || scanner->symbols || scanner->resultStack || scanner->envStack || scanner->popFunc != PDScannerPopSymbol || scanner->bsize < scanner->boffset);
+}
+
+PDBool PDScannerGetUnscannedBuffer(PDScannerRef scanner, const char **buf, PDInteger *len)
+{
+    if (! PDScannerIsIdle(scanner)) return false;
+    
+    *buf = &scanner->buf[scanner->boffset];
+    *len = scanner->bsize - scanner->boffset;
+    return true;
+}
+
+PDBool PDScannerPopInstance(PDScannerRef scanner, void **value)
+{
+    // the direct path is only taken when the scanner is idle at its root state
+    if (! PDScannerIsIdle(scanner))
+        return false;
+    
+    PDInteger i = scanner->boffset;
+    void *inst = PDInstanceCreateFromBuffer(scanner, &i);
+    if (inst == NULL) return false;
+    
+    // like PDScannerPopSymbol, we move past trailing whitespace, but limit newline consumption to nothing, \n, \r, or \r\n
+    char *buf = scanner->buf;
+    PDInteger bsize = scanner->bsize;
+    while (i < bsize && PDOperatorSymbolGlob[(unsigned char)buf[i]] == PDOperatorSymbolGlobWhitespace && buf[i] != '\r' && buf[i] != '\n') i++;
+    if (i < bsize && buf[i] == '\r') i++;
+    if (i < bsize && buf[i] == '\n') i++;
+    
+    scanner->bresoffset = scanner->boffset;
+    scanner->boffset = i;
+    *value = inst;
+    return true;
+}
+
 PDBool PDScannerPopUnknown(PDScannerRef scanner, char **value)
 {
     if (scanner->failed) {
@@ -864,7 +957,7 @@ PDInteger PDScannerReadStream(PDScannerRef scanner, PDInteger bytes, char *dest,
     char *buf;
     PDInteger bsize, i;
 
-    PDAssert(! scanner->symbolStack);
+    PDAssert(scanner->symbols == 0);
     
     buf = scanner->buf;
     bsize = scanner->bsize;
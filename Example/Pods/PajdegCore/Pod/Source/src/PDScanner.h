@@ -104,6 +104,31 @@ extern PDBool PDScannerPopString(PDScannerRef scanner, char **value);
  */
 extern PDBool PDScannerPopStack(PDScannerRef scanner, pd_stack *value);
 
+/**
+ *  Pop the next value as an instance, if it is a dictionary or an array that can be constructed directly from the buffer.
+ *
+ *  This skips the pd_stack representation entirely. If false is returned, the scanner is left as it was, and the value should be popped via PDScannerPopStack() or PDScannerPopString() as usual.
+ *
+ *  @param scanner The scanner
+ *  @param value   Pointer to instance variable. Must be PDRelease()'d
+ *
+ *  @return true if the next value was constructed
+ */
+extern PDBool PDScannerPopInstance(PDScannerRef scanner, void **value);
+
+/**
+ *  Get the part of the scanner's buffer that has not been scanned yet, without scanning anything.
+ *
+ *  This is only possible when nothing has been scanned ahead, i.e. under the same conditions as PDScannerPopInstance(). The buffer may end before the next value does.
+ *
+ *  @param scanner The scanner
+ *  @param buf     Pointer to the buffer variable
+ *  @param len     Pointer to the buffer length variable
+ *
+ *  @return true if buf and len were set
+ */
+extern PDBool PDScannerGetUnscannedBuffer(PDScannerRef scanner, const char **buf, PDInteger *len);
+
 /**
  *  Pop the next value, which the scanner was not able to recognize.
  *
@@ -43,8 +43,10 @@ void PDStateDestroy(PDStateRef state)
         free(state->symbolOp);
     }
     
-    if (state->symindex) 
+    if (state->symindex) {
         free(state->symindex);
+        free(state->symlen);
+    }
     
     PDRelease(state->delimiterOp);
     PDRelease(state->numberOp);
@@ -124,55 +126,47 @@ void PDStateCompile(PDStateRef state)
     if (state->symindex) return; // already compiled
     
     PDInteger symbols = state->symbols;
-    short *hashes = calloc(symbols, sizeof(short));
+    PDInteger *symlen = malloc(sizeof(PDInteger) * (symbols + 1));
+    short *hashes = malloc(sizeof(short) * (symbols + 1));
     
-    PDInteger slen;
-    char *sym;
-    short hash;
     for (i = 0; i < symbols; i++) {
-        hash = 0;
-        sym = state->symbol[i];
-        slen = strlen(sym);
-        for (j = 0; j < slen; j++) 
-            hash -= (PDOperatorSymbolGlob[(unsigned char)sym[j]] - 1) * sym[j];
-        hashes[i] = 10 * abs(hash) + slen;
+        symlen[i] = strlen(state->symbol[i]);
+        hashes[i] = PDOperatorSymbolGlobHash(state->symbol[i], symlen[i]);
     }
     
-    // we want to define the symindex as 2^n >= symbols with minimal collision and minimal n
-    PDInteger n = 2;
-    PDInteger m;
-    while (n < symbols) n <<= 1;    // weak to (very) big symbol tables
+    // states never change once compiled, so we search for a collision free (perfect) hash over the scanner's symbol hash and the first character of the symbol; we want the smallest 2^k >= symbols table for which some multiplier spreads all symbols into separate slots
+    PDInteger n, k, attempt;
+    PDInteger *index = NULL;
+    unsigned int mul = 0;
+    PDBool found = false;
     
-    short coll = 0;
-    PDInteger *index;
-    do {
-        m = n - 1;
-        
-        // n = e.g. 64 = 1000000
-        // m = e.g. 63 = 0111111
-
-        index = calloc(n, sizeof(PDInteger));
-        for (i = 0; i < symbols; i++) {
-            hash = hashes[i] & m;
-            if (index[hash]) {
-                coll++;
-                while (hash < n && index[hash]) hash++;
-                if (hash == n) {
-                    coll = n;
-                    hash = 0;
-                    i = symbols;
-                }
+    for (k = 1, n = 2; n < symbols; k++) n <<= 1;    // weak to (very) big symbol tables
+    
+    for (; ! found && k < 15; k++, n <<= 1) {
+        index = realloc(index, sizeof(PDInteger) * n);
+        mul = 2654435769U; // 2^32 / golden ratio
+        for (attempt = 0; ! found && attempt < 512; attempt++) {
+            state->symhashmul = mul;
+            state->symhashshift = 32 - k;
+            memset(index, 0, sizeof(PDInteger) * n);
+            for (i = 0; i < symbols; i++) {
+                j = PDStateSymbolSlot(state, hashes[i], state->symbol[i][0]);
+                if (index[j]) break;
+                index[j] = i + 1;
             }
-            index[hash] = i+1;
+            found = i == symbols;
+            mul = mul * 1103515245U + 12345U;
+            mul |= 1;
         }
-        if (coll + symbols <= n) break;
-        free(index);
-        n <<= 1;
-    } while (true);
+    }
+    PDAssert(found); // crash = two symbols in the state are identical in both hash and first character
+    k--;
+    
     free(hashes);
     
-    state->symindices = n;
+    state->symindices = 1 << k;
     state->symindex = index;
+    state->symlen = symlen;
     
     for (i = state->symbols - 1; i >= 0; i--) {
         PDOperatorCompileStates(state->symbolOp[i]);
@@ -22,6 +22,8 @@
 // THE SOFTWARE.
 //
 
+#include <errno.h>
+
 #include "pd_internal.h"
 #include "PDStreamFilter.h"
 #include "pd_stack.h"
@@ -137,6 +139,79 @@ PDBool PDStreamFilterApply(PDStreamFilterRef filter, unsigned char *src, unsigne
     return ! filter->failing;
 }
 
+PDBool PDStreamFilterApplyWithSpill(PDStreamFilterRef filter, unsigned char *src, PDInteger len, PDSize threshold, unsigned char **dstPtr, FILE **spillPtr, PDInteger *newlenPtr)
+{
+    *dstPtr = NULL;
+    *spillPtr = NULL;
+    
+    if (! filter->initialized) {
+        if (! PDStreamFilterInit(filter))
+            return false;
+    }
+    
+    PDInteger chunkCap = 64 * 1024;
+    unsigned char *chunk = malloc(chunkCap);
+    unsigned char *resbuf = NULL;
+    PDInteger resCap = 0;
+    FILE *spill = NULL;
+    
+    filter->bufIn = src;
+    filter->bufInAvailable = len;
+    filter->bufOut = chunk;
+    filter->bufOutCapacity = chunkCap;
+    
+    PDBool success = true;
+    PDInteger bytes = PDStreamFilterBegin(filter);
+    PDInteger got = 0;
+    while (success && bytes > 0) {
+        if (NULL == spill && (PDSize)(got + bytes) > threshold) {
+            // we're moving to the spill file; if we can't create one, we stay in memory
+            spill = tmpfile();
+            if (NULL == spill) {
+                PDNotice("unable to create spill file for filtered content (errno %d)", errno);
+                threshold = (PDSize)-1;
+            } else {
+                success = (size_t)got == fwrite(resbuf, 1, got, spill);
+                free(resbuf);
+                resbuf = NULL;
+            }
+        }
+        
+        if (spill) {
+            success &= (size_t)bytes == fwrite(chunk, 1, bytes, spill);
+        } else {
+            if (resCap < got + bytes + 1) {
+                resCap = 2 * (got + bytes + 1);
+                resbuf = realloc(resbuf, resCap);
+            }
+            memcpy(&resbuf[got], chunk, bytes);
+        }
+        got += bytes;
+        
+        filter->bufOut = chunk;
+        filter->bufOutCapacity = chunkCap;
+        bytes = PDStreamFilterProceed(filter);
+    }
+    
+    free(chunk);
+    
+    if (spill) success &= 0 == fflush(spill);
+    
+    if (! success || filter->failing) {
+        if (spill) fclose(spill);
+        free(resbuf);
+        return false;
+    }
+    
+    if (NULL == spill && NULL == resbuf) resbuf = malloc(1);
+    
+    *dstPtr = resbuf;
+    *spillPtr = spill;
+    *newlenPtr = got;
+    
+    return true;
+}
+
 PDBool PDStreamFilterInit(PDStreamFilterRef filter)
 {
     if (! (*filter->init)(filter)) 
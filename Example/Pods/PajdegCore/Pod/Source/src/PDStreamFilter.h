@@ -96,6 +96,7 @@
 #ifndef INCLUDED_PDStreamFilter_h
 #define INCLUDED_PDStreamFilter_h
 
+#include <stdio.h>
 #include "PDDefines.h"
 
 /**
@@ -235,6 +236,23 @@ extern PDInteger PDStreamFilterProceed(PDStreamFilterRef filter);
  */
 extern PDBool PDStreamFilterApply(PDStreamFilterRef filter, unsigned char *src, unsigned char **dstPtr, PDInteger len, PDInteger *newlenPtr, PDInteger *allocatedlenPtr);
 
+/**
+ Apply a filter to the given buffer, spilling the results to a temporary file if they grow too large. 
+ 
+ The results are collected in memory, like PDStreamFilterApply() does, until they exceed threshold bytes; from then on, everything is written to a temporary file instead, in fixed size chunks, so that the filtered content is never held in memory in its entirety. Either *dstPtr or *spillPtr is set on success; the other one is set to NULL.
+ 
+ @param filter    The filter to apply
+ @param src       The source buffer
+ @param len       The length of the source buffer content
+ @param threshold The maximum number of bytes to hold in memory
+ @param dstPtr    The destination buffer pointer; the buffer has room for one more byte beyond the filtered content
+ @param spillPtr  The temporary file pointer; the file is flushed, and its position is at the end of the filtered content
+ @param newlenPtr The filtered content length pointer
+ 
+ @return true on success, false on failure.
+ */
+extern PDBool PDStreamFilterApplyWithSpill(PDStreamFilterRef filter, unsigned char *src, PDInteger len, PDSize threshold, unsigned char **dstPtr, FILE **spillPtr, PDInteger *newlenPtr);
+
 /**
  Create the inversion of the given filter, so that invert(filter(data)) == data
  
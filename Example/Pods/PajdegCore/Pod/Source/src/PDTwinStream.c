@@ -22,25 +22,391 @@
 // THE SOFTWARE.
 //
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#   define _GNU_SOURCE // copy_file_range
+#endif
+
 #include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#   include <sys/sendfile.h>
+#   define PD_TWINSTREAM_KERNEL_COPY
+#endif
 
 #include "Pajdeg.h"
 #include "PDTwinStream.h"
 #include "PDScanner.h"
 
 #include "pd_internal.h"
+#include "PDSplayTree.h"
 
 #define PIO_CHUNK_SIZE  512
+#define PIO_SHUTTLE_SIZE 65536
+#define PIO_BLOCK_SIZE  4096
+#define PIO_READAHEAD_WINDOW    65536
+#define PIO_READAHEAD_WINDOWS   4
+#define PIO_WRITEBEHIND_SIZE    262144
+
+/**
+ A cached, page aligned block of input, used by branch fetches.
+ */
+typedef struct PDTwinStreamBlock *PDTwinStreamBlockRef;
+struct PDTwinStreamBlock {
+    PDTwinStreamBlockRef newer;     ///< next block in LRU list (towards newest)
+    PDTwinStreamBlockRef older;     ///< previous block in LRU list (towards oldest)
+    PDSize index;                   ///< block index, i.e. input offset / PIO_BLOCK_SIZE
+    PDSize length;                  ///< bytes held; less than PIO_BLOCK_SIZE only for the last block in the input
+    char   data[PIO_BLOCK_SIZE + 1];///< content; the extra byte permits in-place NUL termination by the scanner
+};
+
+/**
+ Read-ahead state. A helper thread reads the input, a window at a time, into a ring of windows, which the stream consumes in order.
+ */
+struct PDTwinStreamReadAhead {
+    pthread_t thread;               ///< reader thread
+    pthread_mutex_t lock;           ///< lock guarding everything below
+    pthread_cond_t cond;            ///< signaled whenever a window is filled or released, or the reader is reset or stopped
+    int fd;                         ///< input file descriptor
+    PDBool stop;                    ///< if true, the reader thread exits
+    PDBool eof;                     ///< if true, the reader has reached the end of the input, and waits for a reset
+    PDSize generation;              ///< bumped on every reset, so the reader knows to throw away a read that was in flight
+    PDOffset next;                  ///< input offset of the next window to be read
+    PDInteger head;                 ///< index of the oldest filled window
+    PDInteger count;                ///< number of filled windows
+    struct {
+        PDOffset offset;            ///< input offset of the window
+        PDSize length;              ///< bytes held
+        char data[PIO_READAHEAD_WINDOW]; ///< content
+    } windows[PIO_READAHEAD_WINDOWS];
+};
+
+/**
+ Write-behind state. Output is collected in one of two buffers, while a helper thread writes out the other one.
+ */
+struct PDTwinStreamWriteBehind {
+    pthread_t thread;               ///< writer thread
+    pthread_mutex_t lock;           ///< lock guarding the pending fields and stop
+    pthread_cond_t cond;            ///< signaled whenever a buffer is submitted or written, or the writer is stopped
+    int fd;                         ///< output file descriptor
+    PDBool stop;                    ///< if true, the writer thread exits once nothing is pending
+    int error;                      ///< errno of the last failed write, or 0
+    char *buf[2];                   ///< the two buffers
+    PDInteger cur;                  ///< index of the buffer being filled
+    PDSize len;                     ///< bytes in the buffer being filled
+    PDOffset offset;                ///< output offset of the buffer being filled
+    PDBool pending;                 ///< if true, the other buffer is waiting to be, or is being, written
+    PDOffset pendingOffset;         ///< output offset of the pending buffer
+    PDSize pendingLength;           ///< bytes in the pending buffer
+};
 
 void PDTwinStreamRealign(PDTwinStreamRef ts);
+void PDTwinStreamFlushPassthrough(PDTwinStreamRef ts);
+
+//
+// background I/O
+//
+
+static void *PDTwinStreamReadAheadMain(void *info)
+{
+    struct PDTwinStreamReadAhead *ra = info;
+    PDInteger slot;
+    PDOffset offset;
+    PDSize generation;
+    ssize_t res;
+    
+    pthread_mutex_lock(&ra->lock);
+    while (! ra->stop) {
+        if (ra->eof || ra->count == PIO_READAHEAD_WINDOWS) {
+            pthread_cond_wait(&ra->cond, &ra->lock);
+            continue;
+        }
+        
+        // the window after the last filled one is never touched by the consumer, so we read into it without holding the lock
+        slot = (ra->head + ra->count) % PIO_READAHEAD_WINDOWS;
+        offset = ra->next;
+        generation = ra->generation;
+        pthread_mutex_unlock(&ra->lock);
+        res = pread(ra->fd, ra->windows[slot].data, PIO_READAHEAD_WINDOW, (off_t)offset);
+        pthread_mutex_lock(&ra->lock);
+        
+        // the consumer may have moved elsewhere while we were reading
+        if (generation != ra->generation) continue;
+        
+        if (res <= 0) {
+            ra->eof = true;
+        } else {
+            ra->windows[slot].offset = offset;
+            ra->windows[slot].length = (PDSize)res;
+            ra->next += res;
+            ra->count++;
+        }
+        pthread_cond_broadcast(&ra->cond);
+    }
+    pthread_mutex_unlock(&ra->lock);
+    
+    return NULL;
+}
+
+// must be called with the lock held
+static inline void PDTwinStreamReadAheadReset(struct PDTwinStreamReadAhead *ra, PDOffset offset)
+{
+    ra->generation++;
+    ra->head = ra->count = 0;
+    ra->next = offset;
+    ra->eof = false;
+    pthread_cond_broadcast(&ra->cond);
+}
+
+static PDSize PDTwinStreamReadAheadFetch(struct PDTwinStreamReadAhead *ra, PDOffset offset, char *dst, PDSize bytes)
+{
+    PDSize got = 0;
+    PDSize avail;
+    PDOffset pos;
+    
+    pthread_mutex_lock(&ra->lock);
+    while (got < bytes) {
+        pos = offset + got;
+        
+        if (ra->count == 0) {
+            if (ra->next != pos) {
+                PDTwinStreamReadAheadReset(ra, pos);
+            } else if (ra->eof) {
+                break;
+            }
+            pthread_cond_wait(&ra->cond, &ra->lock);
+            continue;
+        }
+        
+        if (pos < ra->windows[ra->head].offset || pos >= ra->next) {
+            // requested content is not in (or on its way into) the ring, so we start over from the requested offset
+            PDTwinStreamReadAheadReset(ra, pos);
+            continue;
+        }
+        
+        if (pos >= ra->windows[ra->head].offset + ra->windows[ra->head].length) {
+            // content was skipped; release the window
+            ra->head = (ra->head + 1) % PIO_READAHEAD_WINDOWS;
+            ra->count--;
+            pthread_cond_broadcast(&ra->cond);
+            continue;
+        }
+        
+        avail = (PDSize)(ra->windows[ra->head].offset + ra->windows[ra->head].length - pos);
+        if (avail > bytes - got) avail = bytes - got;
+        memcpy(&dst[got], &ra->windows[ra->head].data[pos - ra->windows[ra->head].offset], avail);
+        got += avail;
+        
+        if (pos + avail == ra->windows[ra->head].offset + ra->windows[ra->head].length) {
+            // window used up; hand it back to the reader right away
+            ra->head = (ra->head + 1) % PIO_READAHEAD_WINDOWS;
+            ra->count--;
+            pthread_cond_broadcast(&ra->cond);
+        }
+    }
+    pthread_mutex_unlock(&ra->lock);
+    
+    return got;
+}
+
+static void *PDTwinStreamWriteBehindMain(void *info)
+{
+    struct PDTwinStreamWriteBehind *wb = info;
+    char *buf;
+    PDSize written;
+    ssize_t res;
+    
+    pthread_mutex_lock(&wb->lock);
+    while (true) {
+        while (! wb->pending && ! wb->stop) 
+            pthread_cond_wait(&wb->cond, &wb->lock);
+        if (! wb->pending) break;
+        
+        // the pending buffer is ours until we clear the pending flag
+        buf = wb->buf[1 - wb->cur];
+        pthread_mutex_unlock(&wb->lock);
+        for (written = 0; written < wb->pendingLength; written += res) {
+            res = pwrite(wb->fd, &buf[written], wb->pendingLength - written, (off_t)(wb->pendingOffset + written));
+            if (res <= 0) {
+                wb->error = res < 0 ? errno : EIO;
+                break;
+            }
+        }
+        pthread_mutex_lock(&wb->lock);
+        
+        wb->pending = false;
+        pthread_cond_broadcast(&wb->cond);
+    }
+    pthread_mutex_unlock(&wb->lock);
+    
+    return NULL;
+}
+
+// hand the buffer being filled over to the writer thread, and swap buffers
+static void PDTwinStreamWriteBehindSubmit(struct PDTwinStreamWriteBehind *wb)
+{
+    if (wb->len == 0) return;
+    
+    pthread_mutex_lock(&wb->lock);
+    while (wb->pending) 
+        pthread_cond_wait(&wb->cond, &wb->lock);
+    wb->pending = true;
+    wb->pendingOffset = wb->offset;
+    wb->pendingLength = wb->len;
+    wb->cur = 1 - wb->cur;
+    pthread_cond_broadcast(&wb->cond);
+    pthread_mutex_unlock(&wb->lock);
+    
+    wb->offset += wb->len;
+    wb->len = 0;
+}
+
+// wait for everything collected so far to hit the output file
+static void PDTwinStreamWriteBehindDrain(struct PDTwinStreamWriteBehind *wb)
+{
+    PDTwinStreamWriteBehindSubmit(wb);
+    
+    pthread_mutex_lock(&wb->lock);
+    while (wb->pending) 
+        pthread_cond_wait(&wb->cond, &wb->lock);
+    pthread_mutex_unlock(&wb->lock);
+    
+    if (wb->error) {
+        PDError("write-behind failed to write output (errno %d)", wb->error);
+        wb->error = 0;
+    }
+}
+
+static inline void PDTwinStreamWriteBehindWrite(struct PDTwinStreamWriteBehind *wb, const char *data, PDSize bytes)
+{
+    PDSize room;
+    while (bytes > 0) {
+        room = PIO_WRITEBEHIND_SIZE - wb->len;
+        if (room > bytes) room = bytes;
+        memcpy(&wb->buf[wb->cur][wb->len], data, room);
+        wb->len += room;
+        data += room;
+        bytes -= room;
+        if (wb->len == PIO_WRITEBEHIND_SIZE) 
+            PDTwinStreamWriteBehindSubmit(wb);
+    }
+}
+
+// read input content at the given offset, which is also where the input file handler is positioned (unless reading ahead)
+static inline PDSize PDTwinStreamReadInput(PDTwinStreamRef ts, PDOffset offset, char *dst, PDSize bytes)
+{
+    PDSize read;
+    if (ts->readahead) 
+        read = PDTwinStreamReadAheadFetch(ts->readahead, offset, dst, bytes);
+    else 
+        read = fread(dst, 1, bytes, ts->fi);
+    ts->stats.reads++;
+    ts->stats.bytesRead += read;
+    return read;
+}
+
+// write content to the output, returning the number of bytes written
+static inline PDSize PDTwinStreamWriteOutput(PDTwinStreamRef ts, const char *data, PDSize bytes)
+{
+    ts->stats.writes++;
+    if (ts->writebehind) {
+        PDTwinStreamWriteBehindWrite(ts->writebehind, data, bytes);
+        ts->stats.bytesWritten += bytes;
+        return bytes;
+    }
+    PDSize written = fwrite(data, 1, bytes, ts->fo);
+    ts->stats.bytesWritten += written;
+    return written;
+}
+
+// bring the output file up to date, with its descriptor positioned at the end of the output written so far, so that it can be written to directly
+static inline void PDTwinStreamSyncOutput(PDTwinStreamRef ts)
+{
+    if (ts->writebehind) {
+        PDTwinStreamWriteBehindDrain(ts->writebehind);
+        lseek(ts->writebehind->fd, (off_t)ts->writebehind->offset, SEEK_SET);
+    } else {
+        fflush(ts->fo);
+    }
+}
+
+static void PDTwinStreamStartReadAhead(PDTwinStreamRef ts)
+{
+    struct PDTwinStreamReadAhead *ra = calloc(1, sizeof(struct PDTwinStreamReadAhead));
+    ra->fd = fileno(ts->fi);
+    ra->next = ts->offsi + ts->holds;
+    pthread_mutex_init(&ra->lock, NULL);
+    pthread_cond_init(&ra->cond, NULL);
+    if (pthread_create(&ra->thread, NULL, PDTwinStreamReadAheadMain, ra)) {
+        PDNotice("unable to start read-ahead thread; reading input synchronously");
+        pthread_mutex_destroy(&ra->lock);
+        pthread_cond_destroy(&ra->cond);
+        free(ra);
+        return;
+    }
+    ts->readahead = ra;
+}
+
+static void PDTwinStreamStopReadAhead(PDTwinStreamRef ts)
+{
+    struct PDTwinStreamReadAhead *ra = ts->readahead;
+    
+    pthread_mutex_lock(&ra->lock);
+    ra->stop = true;
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->lock);
+    pthread_join(ra->thread, NULL);
+    
+    pthread_mutex_destroy(&ra->lock);
+    pthread_cond_destroy(&ra->cond);
+    free(ra);
+    ts->readahead = NULL;
+}
+
+static void PDTwinStreamStopWriteBehind(PDTwinStreamRef ts)
+{
+    struct PDTwinStreamWriteBehind *wb = ts->writebehind;
+    
+    PDTwinStreamFlushPassthrough(ts);
+    PDTwinStreamWriteBehindDrain(wb);
+    
+    pthread_mutex_lock(&wb->lock);
+    wb->stop = true;
+    pthread_cond_broadcast(&wb->cond);
+    pthread_mutex_unlock(&wb->lock);
+    pthread_join(wb->thread, NULL);
+    
+    // the output file handler takes over again from where the writer left off
+    fseeko(ts->fo, (off_t)wb->offset, SEEK_SET);
+    
+    pthread_mutex_destroy(&wb->lock);
+    pthread_cond_destroy(&wb->cond);
+    free(wb->buf[0]);
+    free(wb->buf[1]);
+    free(wb);
+    ts->writebehind = NULL;
+}
 
 void PDTwinStreamDestroy(PDTwinStreamRef ts)
 {
 //    PDScannerContextPop();
     
+    if (ts->readahead) PDTwinStreamStopReadAhead(ts);
+    if (ts->writebehind) PDTwinStreamStopWriteBehind(ts);
+    
     PDRelease(ts->scanner);
+    PDRelease(ts->blocks);
     if (ts->sidebuf) free(ts->sidebuf);
-    free(ts->heap);
+    if (ts->mapped && ! ts->spooled) {
+        munmap(ts->heap, ts->size + 1);
+    } else {
+        free(ts->heap);
+    }
+    if (ts->spill) fclose(ts->spill);
 }
 
 PDTwinStreamRef PDTwinStreamCreate(FILE *fi, FILE *fo)
@@ -48,10 +414,230 @@ PDTwinStreamRef PDTwinStreamCreate(FILE *fi, FILE *fo)
     PDTwinStreamRef ts = PDAllocTyped(PDInstanceType2Stream, sizeof(struct PDTwinStream), PDTwinStreamDestroy, true);
     ts->fi = fi;
     ts->fo = fo;
+    ts->cacheBudget = PD_TWINSTREAM_DEFAULT_CACHE_BUDGET;
+    
+#ifdef PD_TWINSTREAM_KERNEL_COPY
+    struct stat st;
+    ts->deferpass = fi && fo && 0 == fstat(fileno(fi), &st) && S_ISREG(st.st_mode);
+#endif
+    
+    return ts;
+}
+
+static PDTwinStreamRef PDTwinStreamCreateWithHeap(char *heap, PDSize len, FILE *fo)
+{
+    PDTwinStreamRef ts = PDTwinStreamCreate(NULL, fo);
+    
+    // in-memory copies are treated like mapped input, except they are freed rather than unmapped; heap must have room for one extra byte beyond len
+    ts->mapped = ts->spooled = true;
+    ts->heap = heap;
+    ts->size = ts->holds = len;
+    ts->deferpass = NULL != fo;
     
     return ts;
 }
 
+PDTwinStreamRef PDTwinStreamCreateWithBuffer(const char *buf, PDSize len, FILE *fo)
+{
+    // the scanner NUL terminates in place (and may touch the byte beyond the end), so we can't use the caller's buffer as is
+    char *heap = malloc(len + 1);
+    memcpy(heap, buf, len);
+    heap[len] = 0;
+    
+    PDTwinStreamRef ts = PDTwinStreamCreateWithHeap(heap, len, fo);
+    ts->stats.peakHeap = len + 1;
+    return ts;
+}
+
+PDTwinStreamRef PDTwinStreamCreateWithSpooledInput(FILE *fi, FILE *fo, PDSize threshold)
+{
+    PDTwinStreamRef ts;
+    PDSize cap = PIO_SHUTTLE_SIZE;
+    PDSize len = 0;
+    PDSize read;
+    PDIOStats stats = {0};
+    FILE *spill;
+    
+    // we always keep an extra byte at the end, for the same reason mapped inputs do
+    char *buf = malloc(cap + 1);
+    
+    // read into memory until EOF or until we hit the threshold
+    while (true) {
+        if (len == cap) {
+            if (cap >= threshold) break;
+            cap = cap * 2 < threshold ? cap * 2 : threshold;
+            buf = realloc(buf, cap + 1);
+            stats.reallocs++;
+        }
+        read = fread(&buf[len], 1, cap - len, fi);
+        stats.reads++;
+        if (read == 0) break;
+        len += read;
+    }
+    stats.bytesRead = len;
+    stats.peakHeap = cap + 1;
+    
+    if (ferror(fi)) {
+        PDError("failed to read non-seekable input (errno %d)", errno);
+        free(buf);
+        return NULL;
+    }
+    
+    if (feof(fi)) {
+        // it all fit; the buffer is handed over to the stream
+        ts = PDTwinStreamCreateWithHeap(buf, len, fo);
+        ts->stats = stats;
+        return ts;
+    }
+    
+    // spill what we have, plus the remainder of the input, to a temporary file, which the stream can seek around in freely
+    spill = tmpfile();
+    if (NULL == spill) {
+        PDError("unable to create spill file for non-seekable input (errno %d)", errno);
+        free(buf);
+        return NULL;
+    }
+    
+    PDBool success = len == fwrite(buf, 1, len, spill);
+    while (success && 0 < (read = fread(buf, 1, cap, fi))) {
+        stats.reads++;
+        stats.bytesRead += read;
+        success = read == fwrite(buf, 1, read, spill);
+    }
+    success &= ! ferror(fi) && 0 == fflush(spill);
+    free(buf);
+    
+    if (! success) {
+        PDError("failed to spill non-seekable input to temporary file (errno %d)", errno);
+        fclose(spill);
+        return NULL;
+    }
+    
+    rewind(spill);
+    ts = PDTwinStreamCreate(spill, fo);
+    ts->spill = spill;
+    ts->stats = stats;
+    return ts;
+}
+
+PDBool PDTwinStreamMapInput(PDTwinStreamRef ts)
+{
+    struct stat st;
+    char *map;
+    int fd;
+    
+    // streams holding their input in memory already have nothing to map
+    if (ts->mapped) return true;
+    
+    PDAssert(ts->heap == NULL); // crash = input must be mapped before the stream is put to use
+    
+    fd = fileno(ts->fi);
+    if (fstat(fd, &st) || st.st_size <= 0) return false;
+    
+    // we reserve one byte beyond the end of the file (rounded up to a page by the system) so that the mutative number readers in the scanner, which NUL terminate in place, never touch unmapped memory; the mapping is private, so nothing ever makes it back to the file
+    map = mmap(NULL, (size_t)st.st_size + 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (map == MAP_FAILED) return false;
+    
+    if (MAP_FAILED == mmap(map, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0)) {
+        munmap(map, (size_t)st.st_size + 1);
+        return false;
+    }
+    
+    ts->mapped = true;
+    ts->heap = map;
+    ts->size = ts->holds = (PDSize)st.st_size;
+    ts->offsi = 0;
+    ts->cursor = 0;
+    
+    // passthrough ranges can always be written straight out of the mapping, if nothing else
+    ts->deferpass = NULL != ts->fo;
+    
+    return true;
+}
+
+PDSize PDTwinStreamGetInputSize(PDTwinStreamRef ts)
+{
+    struct stat st;
+    
+    if (ts->mapped) return ts->size;
+    return 0 == fstat(fileno(ts->fi), &st) && S_ISREG(st.st_mode) ? (PDSize)st.st_size : 0;
+}
+
+void PDTwinStreamBeginIncrementalUpdate(PDTwinStreamRef ts)
+{
+    PDSize size;
+    char last;
+    
+    PDAssert(ts->fo && ts->offso == 0 && ts->passlen == 0); // crash = stream has no output, or output was written to before the update began
+    
+    size = PDTwinStreamGetInputSize(ts);
+    if (ts->mapped) {
+        last = size ? ts->heap[size-1] : '\n';
+    } else {
+        if (size == 0 || 1 != pread(fileno(ts->fi), &last, 1, (off_t)(size - 1))) last = '\n';
+    }
+    
+    ts->incremental = true;
+    
+    // the original goes out as one big passthrough range; the flusher takes care of copying it kernel side (or out of the mapping)
+    ts->passoffs = 0;
+    ts->passlen = size;
+    ts->offso = size;
+    PDTwinStreamFlushPassthrough(ts);
+    
+    // the original may end in "%%EOF" without a trailing newline, in which case the first appended object would be glued onto it
+    if (last != '\n' && last != '\r') {
+        PDTwinStreamInsertContent(ts, 1, "\n");
+    }
+}
+
+PDBool PDTwinStreamEnableReadAhead(PDTwinStreamRef ts)
+{
+    struct stat st;
+    
+    // mapped streams have nothing to gain, and non-regular inputs can't be read at arbitrary offsets
+    if (ts->mapped || NULL == ts->fi || fstat(fileno(ts->fi), &st) || ! S_ISREG(st.st_mode)) 
+        return false;
+    
+    ts->prefetch = true;
+    return true;
+}
+
+PDBool PDTwinStreamEnableWriteBehind(PDTwinStreamRef ts)
+{
+    struct PDTwinStreamWriteBehind *wb;
+    struct stat st;
+    
+    if (ts->writebehind) return true;
+    
+    // output buffers (which have no descriptor) and non-regular outputs can't be written at arbitrary offsets
+    if (NULL == ts->fo || fileno(ts->fo) < 0 || fstat(fileno(ts->fo), &st) || ! S_ISREG(st.st_mode)) 
+        return false;
+    
+    // anything written so far must hit the file first
+    PDTwinStreamFlushPassthrough(ts);
+    fflush(ts->fo);
+    
+    wb = calloc(1, sizeof(struct PDTwinStreamWriteBehind));
+    wb->fd = fileno(ts->fo);
+    wb->offset = ts->offso;
+    wb->buf[0] = malloc(PIO_WRITEBEHIND_SIZE);
+    wb->buf[1] = malloc(PIO_WRITEBEHIND_SIZE);
+    pthread_mutex_init(&wb->lock, NULL);
+    pthread_cond_init(&wb->cond, NULL);
+    if (pthread_create(&wb->thread, NULL, PDTwinStreamWriteBehindMain, wb)) {
+        pthread_mutex_destroy(&wb->lock);
+        pthread_cond_destroy(&wb->cond);
+        free(wb->buf[0]);
+        free(wb->buf[1]);
+        free(wb);
+        return false;
+    }
+    
+    ts->writebehind = wb;
+    return true;
+}
+
 //
 // configuring / querying
 //
@@ -78,13 +664,34 @@ PDScannerRef PDTwinStreamSetupScannerWithState(PDTwinStreamRef ts, PDStateRef st
 
 void PDTWinStreamSetMethod(PDTwinStreamRef ts, PDTwinStreamMethod method)
 {
-    PDAssert(ts->offso == 0);
+    // incremental updates start out with the original input in the output, which is unaffected by the method
+    PDAssert(ts->offso == 0 || ts->incremental);
     
     if (ts->method == method) return;
     
+    // reading ahead only happens in read/write mode
+    if (ts->readahead) PDTwinStreamStopReadAhead(ts);
+    
     PDBool reset = (ts->method == PDTwinStreamReversed) ^ (method == PDTwinStreamReversed);
     ts->method = method;
     
+    if (ts->mapped) {
+        // mapped streams hold the entire input at all times; the cursor is the absolute input offset, except when reversed, where the held content is the tail end of the heap (offsi..size)
+        if (method == PDTwinStreamReversed) {
+            ts->offsi = ts->cursor = ts->size;
+            ts->holds = 0;
+        } else {
+            if (reset) ts->cursor = (PDSize)ts->offsi;
+            ts->offsi = 0;
+            ts->holds = ts->size;
+            if (method == PDTwinStreamReadWrite) {
+                ts->cursor = 0;
+                madvise(ts->heap, ts->size, MADV_SEQUENTIAL);
+            }
+        }
+        return;
+    }
+    
     if (reset) {
         // when switching direction, the heap is purged (in spirit) and the cursor is put at the start (for !rev) or end (for rev)
         PDBool reversedInput = ts->method == PDTwinStreamReversed;
@@ -95,19 +702,23 @@ void PDTWinStreamSetMethod(PDTwinStreamRef ts, PDTwinStreamMethod method)
         
         // we also jump to the start or end of the file 
         
-        PDAssert(ts->offso == 0); // crash = the stream was reversed/unreversed AFTER content was written to output; this is absolutely not supported anywhere or in any way shape form or color
+        PDAssert(ts->offso == 0 || ts->incremental); // crash = the stream was reversed/unreversed AFTER content was written to output; this is absolutely not supported anywhere or in any way shape form or color
         if (reversedInput) {
             fseek(ts->fi, 0, SEEK_END);
             fgetpos(ts->fi, &ts->offsi);
+            ts->stats.seeks++;
         } 
     }
     
     // note: we do not seek to start for RandomAccess, because of the nature of PDF:s -- the xref is at a byte offset, USUALLY at the very end of the file; we're probably AT the end of the file now, and we've probably just unreversed which probably means we've determined xref position and are about to jump the (short) distance there; ReadWrite obviously seeks back to start as it's preparing to begin the stream operation
     if (method == PDTwinStreamReadWrite) {
         fseek(ts->fi, 0, SEEK_SET);
+        ts->stats.seeks++;
         ts->offsi = 0;
         ts->holds = 0;
         ts->cursor = 0;
+        
+        if (ts->prefetch) PDTwinStreamStartReadAhead(ts);
     }
 }
 
@@ -177,8 +788,8 @@ void PDTwinStreamGrowInputBuffer(void *_ts, PDScannerRef scanner, char **buf, PD
     preloaded = ts->holds - (*buf - ts->heap) - *size;
     PDAssert(preloaded >= 0);
     
-    // if we have enough data to cover req, we can give it back instantly
-    if (req > 0 && preloaded >= req) {
+    // if we have enough data to cover req, we can give it back instantly; mapped streams always hand over everything they have, and have nothing more to give
+    if (ts->mapped || (req > 0 && preloaded >= req)) {
         //ts->heap + ts->holds > *buf + *size + req) {
         *size += preloaded;
         return;
@@ -211,7 +822,12 @@ void PDTwinStreamGrowInputBuffer(void *_ts, PDScannerRef scanner, char **buf, PD
             fprintf(stderr, "break!");
             assert(0); // crash = you just ran into an existing bug; please please please let us know how to reproduce this
         }
+        if (ts->ceiling && ts->size > ts->ceiling && ts->size - growth <= ts->ceiling) {
+            PDNotice("input heap grows beyond memory ceiling (%zu bytes) to %zu bytes", (size_t)ts->ceiling, (size_t)ts->size);
+        }
         char *h = realloc(ts->heap, ts->size);
+        ts->stats.reallocs++;
+        if (ts->stats.peakHeap < ts->size) ts->stats.peakHeap = ts->size;
         if (h != ts->heap) {
             // we have to realign buf as heap had to move somewhere else
             ts->heap = h;
@@ -221,7 +837,7 @@ void PDTwinStreamGrowInputBuffer(void *_ts, PDScannerRef scanner, char **buf, PD
     
     // read into heap and update settings
     PDSLogg("reading input bytes %lld .. %lld\n", ts->offsi + ts->holds, ts->offsi + ts->holds + req);
-    PDSize read = fread(&ts->heap[ts->holds], 1, req, ts->fi);
+    PDSize read = PDTwinStreamReadInput(ts, ts->offsi + ts->holds, &ts->heap[ts->holds], req);
     PDSOp("grow");
     PDSLog(req, "grow heap\n");
     ts->holds += read;
@@ -262,6 +878,18 @@ void PDTwinStreamGrowInputBufferReversed(void *_ts, PDScannerRef scanner, char *
         *buf = ts->heap + ts->size - ts->holds;
         return;
     }
+    
+    if (ts->mapped) {
+        // the content is already in place; we simply move the start of the held region back
+        if (req < PIO_CHUNK_SIZE) req = PIO_CHUNK_SIZE;
+        if (req > ts->offsi) req = (PDInteger)ts->offsi;
+        ts->offsi -= req;
+        ts->holds += req;
+        *size = ts->holds;
+        *buf = ts->heap + ts->size - ts->holds;
+        return;
+    }
+    
     // but alas, reading is necessary
     
     capacity = ts->size - ts->holds;
@@ -285,7 +913,10 @@ void PDTwinStreamGrowInputBufferReversed(void *_ts, PDScannerRef scanner, char *
         if (ts->heap) {
             memcpy(&h[growth + offset], &ts->heap[offset], ts->holds);
             free(ts->heap);
+            ts->stats.reversedRebuilds++;
         }
+        ts->stats.reallocs++;
+        if (ts->stats.peakHeap < ts->size) ts->stats.peakHeap = ts->size;
         ts->heap = h;
         
         pos += growth;
@@ -298,7 +929,9 @@ void PDTwinStreamGrowInputBufferReversed(void *_ts, PDScannerRef scanner, char *
     ts->offsi -= req;
     ts->holds += req;
     fseek(ts->fi, (long)ts->offsi, SEEK_SET);
-    fread(&ts->heap[ts->size - ts->holds], 1, req, ts->fi);
+    ts->stats.bytesRead += fread(&ts->heap[ts->size - ts->holds], 1, req, ts->fi);
+    ts->stats.reads++;
+    ts->stats.seeks++;
     *size = ts->holds;
     *buf = ts->heap + ts->size - ts->holds;
     PDAssert(ts->holds <= ts->size);
@@ -320,6 +953,11 @@ void PDTwinStreamSeek(PDTwinStreamRef ts, PDSize position)
 {
     PDAssert(ts->method == PDTwinStreamRandomAccess);
     
+    if (ts->mapped) {
+        ts->cursor = position > ts->size ? ts->size : position;
+        return;
+    }
+    
     if (ts->offsi <= position && ts->offsi + ts->holds > position) {
         ts->cursor = position - (PDSize)ts->offsi;
         return;
@@ -328,9 +966,193 @@ void PDTwinStreamSeek(PDTwinStreamRef ts, PDSize position)
     ts->cursor = 
     ts->holds = 0;
     fseek(ts->fi, position, SEEK_SET);
+    ts->stats.seeks++;
     ts->offsi = position;
 }
 
+//
+// branch block cache
+//
+
+static inline void PDTwinStreamBlockUnlink(PDTwinStreamRef ts, PDTwinStreamBlockRef block)
+{
+    if (block->newer) block->newer->older = block->older; else ts->newest = block->older;
+    if (block->older) block->older->newer = block->newer; else ts->oldest = block->newer;
+    block->newer = block->older = NULL;
+}
+
+static inline void PDTwinStreamBlockLink(PDTwinStreamRef ts, PDTwinStreamBlockRef block)
+{
+    block->older = ts->newest;
+    block->newer = NULL;
+    if (ts->newest) ts->newest->newer = block; else ts->oldest = block;
+    ts->newest = block;
+}
+
+static void PDTwinStreamTrimBlockCache(PDTwinStreamRef ts, PDSize budget)
+{
+    PDTwinStreamBlockRef block;
+    while (ts->oldest && ts->cacheHolds + PIO_BLOCK_SIZE > budget) {
+        block = ts->oldest;
+        PDTwinStreamBlockUnlink(ts, block);
+        ts->cacheHolds -= PIO_BLOCK_SIZE;
+        ts->cacheEvictions++;
+        PDSplayTreeDelete(ts->blocks, block->index); // frees block
+    }
+}
+
+static PDTwinStreamBlockRef PDTwinStreamObtainBlock(PDTwinStreamRef ts, PDSize index, PDOffset *cpos, PDBool *moved)
+{
+    PDTwinStreamBlockRef block = PDSplayTreeGet(ts->blocks, index);
+    
+    if (block) {
+        ts->cacheHits++;
+        PDTwinStreamBlockUnlink(ts, block);
+        PDTwinStreamBlockLink(ts, block);
+        return block;
+    }
+    
+    ts->cacheMisses++;
+    
+    // we only record the position of the input file handler once per fetch, and restore it when done
+    if (! *moved) {
+        fgetpos(ts->fi, cpos);
+        *moved = true;
+    }
+    
+    block = malloc(sizeof(struct PDTwinStreamBlock));
+    fseek(ts->fi, (long)(index * PIO_BLOCK_SIZE), SEEK_SET);
+    block->length = fread(block->data, 1, PIO_BLOCK_SIZE, ts->fi);
+    ts->stats.seeks++;
+    ts->stats.reads++;
+    ts->stats.bytesRead += block->length;
+    if (block->length == 0) {
+        free(block);
+        return NULL;
+    }
+    block->index = index;
+    
+    // make room (one block's worth) before adding
+    PDTwinStreamTrimBlockCache(ts, ts->cacheBudget);
+    PDTwinStreamBlockLink(ts, block);
+    PDSplayTreeInsert(ts->blocks, index, block);
+    ts->cacheHolds += PIO_BLOCK_SIZE;
+    
+    return block;
+}
+
+static PDSize PDTwinStreamFetchCachedBranch(PDTwinStreamRef ts, PDSize position, PDInteger bytes, char **buf)
+{
+    PDTwinStreamBlockRef block;
+    PDSize first, last, index, start, length, fetched;
+    PDOffset cpos;
+    PDBool moved;
+    char *dst;
+    
+    if (ts->blocks == NULL) 
+        ts->blocks = PDSplayTreeCreateWithDeallocator(free);
+    
+    first = position / PIO_BLOCK_SIZE;
+    last = (position + bytes - 1) / PIO_BLOCK_SIZE;
+    moved = false;
+    fetched = 0;
+    
+    // requests contained within a single block are given a pointer straight into the block; others are assembled into the side buffer
+    dst = first == last ? NULL : (ts->sidebuf = malloc(bytes));
+    *buf = dst;
+    
+    for (index = first; index <= last; index++) {
+        block = PDTwinStreamObtainBlock(ts, index, &cpos, &moved);
+        if (NULL == block) break;
+        
+        start = index == first ? position - index * PIO_BLOCK_SIZE : 0;
+        if (start >= block->length) break;
+        length = block->length - start;
+        if (length > bytes - fetched) length = bytes - fetched;
+        
+        if (dst) {
+            memcpy(&dst[fetched], &block->data[start], length);
+        } else {
+            *buf = &block->data[start];
+        }
+        fetched += length;
+        
+        // a short block means we hit the end of the input
+        if (block->length < PIO_BLOCK_SIZE) break;
+    }
+    
+    if (moved) {
+        fseek(ts->fi, (long)cpos, SEEK_SET);
+        ts->stats.seeks++;
+    }
+    
+    if (NULL == *buf) {
+        // nothing at all was fetched
+        *buf = ts->sidebuf = malloc(1);
+    }
+    
+    return fetched;
+}
+
+void PDTwinStreamSetBranchCacheBudget(PDTwinStreamRef ts, PDSize bytes)
+{
+    ts->cacheBudget = bytes;
+    if (ts->blocks) 
+        PDTwinStreamTrimBlockCache(ts, bytes);
+}
+
+void PDTwinStreamGetBranchCacheCounters(PDTwinStreamRef ts, PDSize *hits, PDSize *misses, PDSize *evictions)
+{
+    if (hits) *hits = ts->cacheHits;
+    if (misses) *misses = ts->cacheMisses;
+    if (evictions) *evictions = ts->cacheEvictions;
+}
+
+void PDTwinStreamSetMemoryCeiling(PDTwinStreamRef ts, PDSize bytes)
+{
+    ts->ceiling = bytes;
+}
+
+void PDTwinStreamGetStats(PDTwinStreamRef ts, PDIOStats *stats)
+{
+    *stats = ts->stats;
+    stats->cacheHits = ts->cacheHits;
+    stats->cacheMisses = ts->cacheMisses;
+    stats->cacheEvictions = ts->cacheEvictions;
+}
+
+PDOffset PDTwinStreamGetScannerInputOffset(PDTwinStreamRef ts)
+{
+    PDScannerRef scanner = ts->scanner;
+    PDOffset pos = scanner->buf ? scanner->buf - ts->heap : (PDOffset)ts->cursor;
+    return ts->offsi + pos + scanner->boffset;
+}
+
+PDSize PDTwinStreamReadRange(PDTwinStreamRef ts, PDOffset position, PDSize bytes, char *dst)
+{
+    PDSize read = 0;
+    ssize_t res;
+    
+    if (ts->mapped) {
+        if ((PDSize)position >= ts->size) return 0;
+        read = bytes > ts->size - position ? ts->size - position : bytes;
+        memcpy(dst, ts->heap + position, read);
+        return read;
+    }
+    
+    // we read straight off of the descriptor, which leaves the input file handler (and its position) alone
+    int fd = fileno(ts->fi);
+    while (read < bytes) {
+        res = pread(fd, &dst[read], bytes - read, (off_t)(position + read));
+        if (res <= 0) break;
+        read += res;
+        ts->stats.reads++;
+        ts->stats.bytesRead += res;
+    }
+    
+    return read;
+}
+
 PDSize PDTwinStreamFetchBranch(PDTwinStreamRef ts, PDSize position, PDInteger bytes, char **buf)
 {
     // discard existing branch buffer, if any
@@ -339,6 +1161,17 @@ PDSize PDTwinStreamFetchBranch(PDTwinStreamRef ts, PDSize position, PDInteger by
 
     // clear outgrown flag (this is only ever used for branches)
     ts->outgrown = false;
+    ts->stats.branchFetches++;
+    
+    if (ts->mapped) {
+        // the whole file is in memory, so we point straight into it, regardless of method
+        if (position >= ts->size) {
+            *buf = ts->heap + ts->size;
+            return 0;
+        }
+        *buf = ts->heap + position;
+        return (PDSize)bytes > ts->size - position ? ts->size - position : (PDSize)bytes;
+    }
     
     PDInteger alignment = (PDInteger)(position - ts->offsi);
     PDInteger covered = (PDInteger)(ts->holds - alignment);
@@ -354,6 +1187,11 @@ PDSize PDTwinStreamFetchBranch(PDTwinStreamRef ts, PDSize position, PDInteger by
         return bytes;
     }
     
+    // requests that fit comfortably within the block cache budget go through the cache
+    if (bytes > 0 && (PDSize)bytes <= ts->cacheBudget / 2) {
+        return PDTwinStreamFetchCachedBranch(ts, position, bytes, buf);
+    }
+    
     // we set up a dedicated buffer for this request
     PDOffset cpos;
     fgetpos(ts->fi, &cpos);
@@ -361,12 +1199,20 @@ PDSize PDTwinStreamFetchBranch(PDTwinStreamRef ts, PDSize position, PDInteger by
     *buf = ts->sidebuf = malloc(bytes);
     PDSize read = fread(ts->sidebuf, 1, bytes, ts->fi);
     fseek(ts->fi, (long)cpos, SEEK_SET);
+    ts->stats.seeks += 2;
+    ts->stats.reads++;
+    ts->stats.bytesRead += read;
     return read;
 }
 
 #ifdef PD_DEBUG_TWINSTREAM_ASSERT_OBJECTS
 void PDTwinStreamReassert(PDTwinStreamRef ts, PDOffset offset, char *expect, PDInteger len)
 {
+    if (NULL == ts->fo) return;
+    
+    PDTwinStreamFlushPassthrough(ts);
+    if (ts->writebehind) PDTwinStreamWriteBehindDrain(ts->writebehind);
+    
     // we set up a dedicated buffer for this request
     PDOffset cpos;
     fgetpos(ts->fo, &cpos);
@@ -410,10 +1256,16 @@ void PDTwinStreamCutBranch(PDTwinStreamRef ts, char *buf)
 void PDTwinStreamAsserts(PDTwinStreamRef ts)
 {
     PDOffset fp;
-    fgetpos(ts->fi, &fp);
-    PDAssert(fp == ts->offsi + ts->holds);
-    fgetpos(ts->fo, &fp);
-    PDAssert(fp == ts->offso);
+    if (! ts->mapped && ! ts->readahead) {
+        fgetpos(ts->fi, &fp);
+        PDAssert(fp == ts->offsi + ts->holds);
+    }
+    if (ts->writebehind) {
+        PDAssert(ts->writebehind->offset + ts->writebehind->len + ts->passlen == ts->offso);
+    } else if (ts->fo) {
+        fgetpos(ts->fo, &fp);
+        PDAssert(fp + ts->passlen == ts->offso);
+    }
 
     /*
     if (ts->scanner && ts->scanner->buf) {
@@ -445,6 +1297,7 @@ void PDTwinStreamRealign(PDTwinStreamRef ts)
     PDTwinStreamAsserts(ts);
 }
 
+void PDTwinStreamOperatorPassthrough(PDTwinStreamRef ts, char *buf, PDSize bytes);
 void PDTwinStreamOperatorDiscard(PDTwinStreamRef ts, char *buf, PDSize bytes);
 
 void PDTwinStreamOperateOnContent(PDTwinStreamRef ts, PDOffset bytes, void(*op)(PDTwinStreamRef, char *, PDSize))
@@ -457,11 +1310,34 @@ void PDTwinStreamOperateOnContent(PDTwinStreamRef ts, PDOffset bytes, void(*op)(
     
     PDSLogg("[stream] from %lld the next %lld bytes\n", ts->offsi + ts->cursor, bytes);
     
-    if (ts->size < 6*PIO_CHUNK_SIZE && bytes > 6*PIO_CHUNK_SIZE) {
+    if (NULL == ts->fo && op == &PDTwinStreamOperatorPassthrough) {
+        // there is no output, so passing through is the same as discarding, except the output offset still moves
+        ts->offso += bytes;
+        op = &PDTwinStreamOperatorDiscard;
+    }
+    
+    if (ts->deferpass && op == &PDTwinStreamOperatorPassthrough) {
+        // passthrough content is queued as an input range, and the stream is moved past it just as if it were discarded
+        PDOffset start = ts->offsi + ts->cursor;
+        if (ts->passlen && ts->passoffs + ts->passlen != start) 
+            PDTwinStreamFlushPassthrough(ts);
+        if (ts->passlen == 0) 
+            ts->passoffs = start;
+        ts->passlen += bytes;
+        ts->offso += bytes;
+        op = &PDTwinStreamOperatorDiscard;
+    }
+    
+    if (! ts->mapped && ts->size < 6*PIO_CHUNK_SIZE && bytes > 6*PIO_CHUNK_SIZE) {
         // big requests will loop a lot if we get them early and heap is small
         PDTwinStreamGrowInputBuffer(ts, ts->scanner, &ts->scanner->buf, &ts->scanner->bsize, 6*PIO_CHUNK_SIZE);
     }
     
+    if (ts->mapped && ts->holds - ts->cursor < bytes) {
+        PDAssert(0); // crash = attempt to operate on more content than input stream has available; sure sign of corruption
+        bytes = ts->holds - ts->cursor;
+    }
+
     if (ts->holds - ts->cursor < bytes) {
         // remainder of heap can be passed through
         PDSLog(ts->holds - ts->cursor, "[and more] (whole heap)\n");
@@ -473,14 +1349,17 @@ void PDTwinStreamOperateOnContent(PDTwinStreamRef ts, PDOffset bytes, void(*op)(
         
         if (bytes > 0) {
             if (op == &PDTwinStreamOperatorDiscard) {
-                // the discard operator is NOP, so there's no point reading and discarding anything
-                fseek(ts->fi, (long)bytes, SEEK_CUR);
+                // the discard operator is NOP, so there's no point reading and discarding anything (the read-ahead reader skips along by itself)
+                if (! ts->readahead) {
+                    fseek(ts->fi, (long)bytes, SEEK_CUR);
+                    ts->stats.seeks++;
+                }
             } else {
                 // use the heap as a shuttle for remaining content
                 PDSize req, read;
                 while (bytes > 0) {
                     req = bytes < ts->size ? (PDInteger)bytes : ts->size;
-                    read = fread(ts->heap, 1, req, ts->fi);
+                    read = PDTwinStreamReadInput(ts, ts->offsi - bytes, ts->heap, req);
                     (*op)(ts, ts->heap, read);
                     bytes -= read;
                     if (read < req) {
@@ -493,6 +1372,12 @@ void PDTwinStreamOperateOnContent(PDTwinStreamRef ts, PDOffset bytes, void(*op)(
         
         // reset master scanner as it's now completely out of data
         PDScannerReset(ts->scanner);
+        
+        // nothing refers to the heap at this point, so if it grew beyond the memory ceiling, we shrink it back down
+        if (ts->ceiling && ts->size > ts->ceiling && ! ts->mapped) {
+            ts->size = ts->ceiling < PIO_SHUTTLE_SIZE ? PIO_SHUTTLE_SIZE : ts->ceiling;
+            ts->heap = realloc(ts->heap, ts->size);
+        }
         return;
     }
 
@@ -503,21 +1388,107 @@ void PDTwinStreamOperateOnContent(PDTwinStreamRef ts, PDOffset bytes, void(*op)(
     PDScannerTrim(ts->scanner, bytes);
     PDTwinStreamAsserts(ts);
     
-    // we realign stream when opportune
-    if (ts->cursor * 2 > ts->size) {
+    // we realign stream when opportune (mapped streams never move)
+    if (! ts->mapped && ts->cursor * 2 > ts->size) {
         PDTwinStreamRealign(ts);
     }
 }
 
 void PDTwinStreamOperatorPassthrough(PDTwinStreamRef ts, char *buf, PDSize bytes)
 {
-    fwrite(buf, 1, bytes, ts->fo);
+    PDTwinStreamWriteOutput(ts, buf, bytes);
     ts->offso += bytes;
 }
 
 void PDTwinStreamOperatorDiscard(PDTwinStreamRef ts, char *buf, PDSize bytes)
 {}
 
+#ifdef PD_TWINSTREAM_KERNEL_COPY
+static inline PDSize PDTwinStreamKernelCopy(int fdi, int fdo, PDOffset start, PDSize bytes)
+{
+    PDSize copied = 0;
+    loff_t offs = start;
+    ssize_t res;
+    
+    // copy_file_range copies within the kernel (and may even share extents on file systems supporting it); older kernels and cross file system copies fall back to sendfile
+    while (copied < bytes) {
+        res = copy_file_range(fdi, &offs, fdo, NULL, bytes - copied, 0);
+        if (res <= 0) break;
+        copied += res;
+    }
+    
+    while (copied < bytes) {
+        off_t soffs = (off_t)offs;
+        res = sendfile(fdo, fdi, &soffs, bytes - copied);
+        if (res <= 0) break;
+        offs = soffs;
+        copied += res;
+    }
+    
+    return copied;
+}
+#endif
+
+void PDTwinStreamFlushPassthrough(PDTwinStreamRef ts)
+{
+    if (ts->passlen == 0) return;
+    
+    PDOffset start = ts->passoffs;
+    PDSize bytes = ts->passlen;
+    PDSize copied = 0;
+    ts->passlen = 0;
+    
+    if (ts->mapped) {
+        // the content is already in memory, so we simply write it out in one go
+        PDTwinStreamWriteOutput(ts, &ts->heap[start], bytes);
+        return;
+    }
+    
+    // the output file handler's (or write-behind) buffer must hit the disk before we write to the descriptor behind its back
+    PDTwinStreamSyncOutput(ts);
+    
+    int fdi = fileno(ts->fi);
+    int fdo = fileno(ts->fo);
+    
+#ifdef PD_TWINSTREAM_KERNEL_COPY
+    copied = PDTwinStreamKernelCopy(fdi, fdo, start, bytes);
+    ts->stats.writes++;
+    ts->stats.bytesWritten += copied;
+    if (copied < bytes) {
+        // the kernel won't do it for us, so we stop deferring from here on
+        PDNotice("kernel side copy unavailable (errno %d); falling back to buffered passthrough", errno);
+        ts->deferpass = false;
+    }
+#endif
+    
+    if (copied < bytes) {
+        // buffered fallback
+        char *shuttle = malloc(PIO_SHUTTLE_SIZE);
+        ssize_t req, res;
+        while (copied < bytes) {
+            req = bytes - copied < PIO_SHUTTLE_SIZE ? (ssize_t)(bytes - copied) : PIO_SHUTTLE_SIZE;
+            res = pread(fdi, shuttle, req, (off_t)(start + copied));
+            if (res <= 0 || write(fdo, shuttle, res) != res) {
+                PDAssert(0); // crash = attempt to pass through more content than input stream has available, or output is unwritable
+                break;
+            }
+            copied += res;
+            ts->stats.reads++;
+            ts->stats.writes++;
+            ts->stats.bytesRead += res;
+            ts->stats.bytesWritten += res;
+        }
+        free(shuttle);
+    }
+    
+    // the file handler (or write-behind buffer) must now be told where the descriptor ended up
+    if (ts->writebehind) {
+        ts->writebehind->offset = ts->offso;
+    } else {
+        fseeko(ts->fo, (off_t)ts->offso, SEEK_SET);
+    }
+}
+
 void PDTWinStreamPassthroughContent(PDTwinStreamRef ts)//, PDSize bytes)
 {
     PDSOp("pass");
@@ -542,5 +1513,10 @@ void PDTwinStreamPrune(PDTwinStreamRef ts, PDOffset mark)
 
 void PDTwinStreamInsertContent(PDTwinStreamRef ts, PDSize bytes, const char *content)
 {
-    ts->offso += fwrite(content, 1, bytes, ts->fo);
+    if (NULL == ts->fo) {
+        ts->offso += bytes;
+        return;
+    }
+    PDTwinStreamFlushPassthrough(ts);
+    ts->offso += PDTwinStreamWriteOutput(ts, content, bytes);
 }
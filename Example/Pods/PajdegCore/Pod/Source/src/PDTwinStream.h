@@ -51,16 +51,106 @@
 #include <stdio.h>
 #include "PDDefines.h"
 
+/**
+ The default byte budget for the branch fetch block cache.
+ 
+ @see PDTwinStreamSetBranchCacheBudget
+ */
+#define PD_TWINSTREAM_DEFAULT_CACHE_BUDGET  (1 << 20)
+
+/**
+ The default number of bytes of non-seekable input that are held in memory, before the input is spilled to a temporary file.
+ 
+ @see PDTwinStreamCreateWithSpooledInput
+ */
+#define PD_TWINSTREAM_DEFAULT_SPOOL_THRESHOLD  (16 << 20)
+
 /// @name Construction
 
 /**
  Create a new stream with the given file handlers.
  
  @param fi Input file handler.
- @param fo Output file handler.
+ @param fo Output file handler, or NULL for a stream without output (readonly mode).
  */
 extern PDTwinStreamRef PDTwinStreamCreate(FILE *fi, FILE *fo);
 
+/**
+ Create a new stream reading from the given buffer, and writing to the given file handler.
+ 
+ The stream behaves like a stream whose input is memory mapped (see PDTwinStreamMapInput()).
+ 
+ @param buf The input buffer. The stream works on a private copy of the buffer, so the caller may release or modify it as soon as this function returns.
+ @param len The length of the input buffer.
+ @param fo Output file handler, or NULL for a stream without output (readonly mode).
+ */
+extern PDTwinStreamRef PDTwinStreamCreateWithBuffer(const char *buf, PDSize len, FILE *fo);
+
+/**
+ Create a new stream reading from a non-seekable input (a pipe, socket, etc.), and writing to the given file handler.
+ 
+ PDFs are read back to front (the xref table is at the end), so the input is consumed in its entirety up front. Up to threshold bytes are held in memory, in which case the stream behaves like a buffer stream (see PDTwinStreamCreateWithBuffer()); larger inputs are spilled to a temporary file, which the stream then reads from like any other input file.
+ 
+ @param fi Input file handler. It is read until EOF, but is never seeked, and is not closed by the stream.
+ @param fo Output file handler, or NULL for a stream without output (readonly mode).
+ @param threshold The maximum number of bytes to hold in memory.
+ @return The stream, or NULL if the input could not be read, or the temporary file could not be created.
+ */
+extern PDTwinStreamRef PDTwinStreamCreateWithSpooledInput(FILE *fi, FILE *fo, PDSize threshold);
+
+/**
+ Memory map the input file of the stream.
+ 
+ A mapped stream holds the entire input in its heap at all times. Buffer growth, reversed reads, seeking and branch fetches all become pointer arithmetic, and no content is copied or read through the file handler.
+ 
+ @note Must be called before the stream is put to use.
+ 
+ @param ts The stream.
+ @return true if the input was mapped, false if mapping failed (e.g. empty or non-regular input), in which case the stream remains a regular reading stream.
+ */
+extern PDBool PDTwinStreamMapInput(PDTwinStreamRef ts);
+
+/**
+ Get the size of the input, in bytes.
+ 
+ @param ts The stream.
+ @return The size of the input, or 0 if it could not be determined (e.g. for non-regular inputs that were never spooled).
+ */
+extern PDSize PDTwinStreamGetInputSize(PDTwinStreamRef ts);
+
+/**
+ Begin an incremental update on the stream.
+ 
+ The input is copied to the output, untouched and in its entirety, and the output offset is moved to the end of the copy. From this point on, discarded content is simply skipped, and passed through and inserted content ends up after the original, which is what an incremental update section consists of.
+ 
+ @note Must be called before anything is written to the output.
+ 
+ @param ts The stream.
+ */
+extern void PDTwinStreamBeginIncrementalUpdate(PDTwinStreamRef ts);
+
+/**
+ Enable reading ahead on the stream.
+ 
+ While the stream is in read/write mode, a helper thread reads the next windows of input ahead of time, so that the scanner rarely has to wait on the input file when growing its buffer. The reader follows along when content is skipped.
+ 
+ @note Takes effect the next time the stream switches to read/write mode, i.e. it should be enabled before the stream is handed to a parser.
+ 
+ @param ts The stream.
+ @return true if reading ahead was enabled, false if the stream is memory mapped, or its input is not a regular file.
+ */
+extern PDBool PDTwinStreamEnableReadAhead(PDTwinStreamRef ts);
+
+/**
+ Enable writing behind on the stream.
+ 
+ Output is collected in a buffer, which is handed over to a helper thread for writing once full, while output continues into a second buffer. Everything is written out when the stream is destroyed.
+ 
+ @param ts The stream.
+ @return true if writing behind was enabled, false if the stream has no output, or its output is not a regular file.
+ */
+extern PDBool PDTwinStreamEnableWriteBehind(PDTwinStreamRef ts);
+
 /// @name Configuring / querying
 
 /**
@@ -106,6 +196,34 @@ extern PDScannerRef PDTwinStreamSetupScannerWithState(PDTwinStreamRef ts, PDStat
  */
 #define PDTwinStreamGetOutputOffset(str) (str->offso)
 
+/**
+ Determine whether the given stream has an output. Streams without an output drop all passthrough and inserted content, but keep track of the output offset as if it had been written.
+ 
+ @param str Stream.
+ */
+#define PDTwinStreamHasOutput(str) (NULL != str->fo)
+
+/**
+ Determine whether the given stream is writing an incremental update, i.e. whether the original input precedes everything written to the output.
+ 
+ @param str Stream.
+ */
+#define PDTwinStreamIsIncremental(str) (str->incremental)
+
+/**
+ Get the input offset of the master scanner's current position.
+ 
+ @param ts The stream.
+ */
+extern PDOffset PDTwinStreamGetScannerInputOffset(PDTwinStreamRef ts);
+
+/**
+ Get the memory ceiling of the stream.
+ 
+ @param str The stream.
+ */
+#define PDTwinStreamGetMemoryCeiling(str) (str->ceiling)
+
 /// @name Reading 
 
 /**
@@ -184,6 +302,59 @@ extern void PDTwinStreamAdvance(PDTwinStreamRef ts, PDSize bytes);
  */
 extern PDSize PDTwinStreamFetchBranch(PDTwinStreamRef ts, PDSize position, PDInteger bytes, char **buf);
 
+/**
+ Set the byte budget of the block cache used by PDTwinStreamFetchBranch().
+ 
+ Branch fetches that are not covered by the heap are served out of a cache of page aligned blocks of input, evicting the least recently used blocks when the budget is reached. Requests larger than half the budget bypass the cache. Mapped streams never use the cache.
+ 
+ @param ts The stream.
+ @param bytes The budget in bytes. 0 disables the cache. Default is PD_TWINSTREAM_DEFAULT_CACHE_BUDGET.
+ */
+extern void PDTwinStreamSetBranchCacheBudget(PDTwinStreamRef ts, PDSize bytes);
+
+/**
+ Get the branch fetch block cache counters.
+ 
+ Each counter is per block, i.e. a fetch spanning three blocks adds three to hits and misses combined. Any of the pointers may be NULL.
+ 
+ @param ts The stream.
+ @param hits Pointer to the number of blocks served from the cache.
+ @param misses Pointer to the number of blocks read from input.
+ @param evictions Pointer to the number of blocks evicted.
+ */
+extern void PDTwinStreamGetBranchCacheCounters(PDTwinStreamRef ts, PDSize *hits, PDSize *misses, PDSize *evictions);
+
+/**
+ Get the I/O statistics of the stream so far.
+
+ @param ts The stream.
+ @param stats Pointer to the statistics struct to fill in.
+ */
+extern void PDTwinStreamGetStats(PDTwinStreamRef ts, PDIOStats *stats);
+
+/**
+ Set the memory ceiling of the stream. 
+ 
+ The heap is shrunk back down whenever it has grown beyond the ceiling and is emptied, and the parser keeps stream content larger than the ceiling in temporary files instead of on the heap. A ceiling of 0 (the default) means there is no ceiling.
+ 
+ @param ts The stream.
+ @param bytes The ceiling in bytes, or 0.
+ */
+extern void PDTwinStreamSetMemoryCeiling(PDTwinStreamRef ts, PDSize bytes);
+
+/**
+ Read a range of the input into the given buffer, without affecting the stream's state. 
+ 
+ Unlike PDTwinStreamFetchBranch(), the content is read straight into the caller's buffer, and nothing is kept around afterwards.
+ 
+ @param ts The stream.
+ @param position The input offset to read from.
+ @param bytes The number of bytes to read.
+ @param dst The buffer to read into, which must be able to hold bytes bytes.
+ @return The number of bytes read, which is less than bytes if the input ends first.
+ */
+extern PDSize PDTwinStreamReadRange(PDTwinStreamRef ts, PDOffset position, PDSize bytes, char *dst);
+
 /**
  Deallocate (if necessary) a fetched branch buffer.
 
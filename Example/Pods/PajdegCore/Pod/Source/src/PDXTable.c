@@ -22,13 +22,23 @@
 // THE SOFTWARE.
 //
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#   define _GNU_SOURCE // memmem
+#endif
+
 #include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "pd_internal.h"
 #include "PDParser.h"
 #include "PDTwinStream.h"
 #include "PDScanner.h"
 #include "pd_stack.h"
+#include "pd_work_queue.h"
 #include "PDXTable.h"
 #include "PDReference.h"
 #include "PDObject.h"
@@ -39,6 +49,7 @@
 #include "PDArray.h"
 #include "PDString.h"
 #include "PDNumber.h"
+#include "PDOperator.h"
 
 #define xrefalloc(tbl, cap, width)           malloc((cap) * (width) + 1); tbl->allocx = (cap) * (width) + 1
 #define xrefrealloc(tbl, xref, cap, width)   realloc(xref, (cap) * (width) + 1); tbl->allocx = (cap) * (width) + 1
@@ -66,7 +77,7 @@ PDOffset PDXGetOffsetForArbitraryRepresentation(char *rep, PDInteger len)
     return ot;
 }
 
-PDOffset PDXTableGetOffsetForID(PDXTableRef table, PDInteger obid)
+static inline PDOffset PDXTableGetPackedOffsetForID(PDXTableRef table, PDInteger obid)
 {
     unsigned char *o = (unsigned char *) &table->xrefs[table->offsAlign + obid * table->width];
     
@@ -93,6 +104,11 @@ PDOffset PDXTableGetOffsetForID(PDXTableRef table, PDInteger obid)
     return r;
 }
 
+PDOffset PDXTableGetOffsetForID(PDXTableRef table, PDInteger obid)
+{
+    return table->decOffs ? table->decOffs[obid] : PDXTableGetPackedOffsetForID(table, obid);
+}
+
 #define _PDXSetTypeForID(xrefs, table, id, t)    *(PDXType*)&((xrefs)[id*table->width]) = t
 
 void _PDXSetOffsetForID(char *xrefs, PDXTableRef table, PDInteger obid, PDOffset offset)
@@ -124,9 +140,11 @@ void PDXTableSetOffsetForID(PDXTableRef table, PDInteger obid, PDOffset offset)
         mask <<= 8;
         shift += 8;
     }
+    
+    if (table->decOffs) table->decOffs[obid] = offset;
 }
 
-PDInteger PDXTableGetGenForID(PDXTableRef table, PDInteger obid)
+static inline PDInteger PDXTableGetPackedGenForID(PDXTableRef table, PDInteger obid)
 {
     unsigned char *o = (unsigned char *) &table->xrefs[table->genAlign + obid * table->width];
     
@@ -153,6 +171,11 @@ PDInteger PDXTableGetGenForID(PDXTableRef table, PDInteger obid)
     return r;
 }
 
+PDInteger PDXTableGetGenForID(PDXTableRef table, PDInteger obid)
+{
+    return table->decGens ? table->decGens[obid] : PDXTableGetPackedGenForID(table, obid);
+}
+
 void PDXTableSetGenForID(PDXTableRef table, PDInteger obid, PDInteger gen)
 {
     unsigned char *o = (unsigned char *) &table->xrefs[table->genAlign + obid * table->width];
@@ -163,7 +186,9 @@ void PDXTableSetGenForID(PDXTableRef table, PDInteger obid, PDInteger gen)
         mask <<= 8;
         shift += 8;
     }
-    PDAssert(PDXTableGetGenForID(table, obid) == gen);
+    PDAssert(PDXTableGetPackedGenForID(table, obid) == gen);
+    
+    if (table->decGens) table->decGens[obid] = gen;
 }
 
 void _PDXSetGenForID(char *xrefs, PDXTableRef table, PDInteger obid, PDInteger gen)
@@ -179,6 +204,98 @@ void _PDXSetGenForID(char *xrefs, PDXTableRef table, PDInteger obid, PDInteger g
 //    PDAssert(PDXTableGetGenForID(table, obid) == gen);
 }
 
+static inline void PDXTableSetEntries(PDXTableRef table, PDInteger startob, PDInteger count, PDOffset *offs, PDInteger *gens, PDXType *types)
+{
+    char *dst = &table->xrefs[startob * table->width];
+    for (PDInteger i = 0; i < count; i++) {
+        _PDXSetTypeForID(dst, table, i, types[i]);
+        _PDXSetOffsetForID(dst, table, i, offs[i]);
+        _PDXSetGenForID(dst, table, i, gens[i]);
+    }
+    
+    if (table->decOffs) {
+        memcpy(&table->decOffs[startob], offs, count * sizeof(PDOffset));
+        memcpy(&table->decGens[startob], gens, count * sizeof(PDInteger));
+        memcpy(&table->decTypes[startob], types, count);
+    }
+}
+
+static inline PDOffset PDXDecodeBigEndian(const unsigned char *src, PDInteger len)
+{
+    PDOffset v = 0;
+    for (PDInteger i = 0; i < len; i++) v = (v << 8) | src[i];
+    return v;
+}
+
+/**
+ Decode count rows of an XRef stream, whose fields are sizeT, sizeO, and sizeI bytes wide, into the given arrays.
+ 
+ The common layouts get their own loops, so that the field widths are constants the compiler can unroll and vectorize.
+ */
+static void PDXDecodeStreamEntries(const unsigned char *src, PDInteger count, PDInteger sizeT, PDInteger sizeO, PDInteger sizeI, PDOffset *offs, PDInteger *gens, PDXType *types)
+{
+    PDInteger i;
+    
+#define decode_rows(T, O, I) \
+    for (i = 0; i < count; i++) { \
+        types[i] = T ? (PDXType)PDXDecodeBigEndian(src, T) : PDXTypeUsed; \
+        offs[i] = PDXDecodeBigEndian(&src[T], O); \
+        gens[i] = (PDInteger)PDXDecodeBigEndian(&src[T + O], I); \
+        src += T + O + I; \
+    }
+    
+    if (sizeT == 1) {
+        switch (sizeO << 4 | sizeI) {
+            case 0x21: decode_rows(1, 2, 1); return;
+            case 0x22: decode_rows(1, 2, 2); return;
+            case 0x31: decode_rows(1, 3, 1); return;
+            case 0x32: decode_rows(1, 3, 2); return;
+            case 0x41: decode_rows(1, 4, 1); return;
+            case 0x42: decode_rows(1, 4, 2); return;
+        }
+    }
+    decode_rows(sizeT, sizeO, sizeI);
+    
+#undef decode_rows
+}
+
+/**
+ Decode count 20-byte text XRef entries ("oooooooooo ggggg n \n") into the given arrays.
+ 
+ The fields are fixed width, so digits are accumulated positionally; rows with anything but digits in their number fields fall back to atol.
+ */
+static void PDXDecodeTextEntries(char *src, PDInteger count, PDOffset *offs, PDInteger *gens, PDXType *types)
+{
+    const unsigned char *s;
+    unsigned char d, bad;
+    PDOffset o;
+    PDInteger g;
+    PDInteger i, k;
+    
+    for (i = 0; i < count; i++, src += 20) {
+        s = (const unsigned char *)src;
+        bad = 0;
+        o = g = 0;
+        for (k = 0; k < 10; k++) {
+            d = s[k] - '0';
+            bad |= d > 9;
+            o = o * 10 + d;
+        }
+        for (k = 11; k < 16; k++) {
+            d = s[k] - '0';
+            bad |= d > 9;
+            g = g * 10 + d;
+        }
+        if (bad) {
+            o = fast_mutative_atol(src, 10);
+            g = fast_mutative_atol(&src[11], 5);
+        }
+        offs[i] = o;
+        gens[i] = g;
+        types[i] = s[17] == 'n' ? PDXTypeUsed : PDXTypeFreed;
+    }
+}
+
 
 typedef struct PDXI *PDXI;
 
@@ -222,9 +339,57 @@ struct PDXI {
     0, \
 }
 
+typedef struct PDXSection *PDXSection;
+
+/**
+ An XRef section, read from the input but not yet merged into a table.
+ 
+ Sections are read one after the other, as they share the input stream and scanner, but are decoded (and inflated, if compressed) independently of each other, so that decoding can be spread across threads.
+ */
+struct PDXSection {
+    PDOffset pos;               ///< input offset of the section
+    PDXFormat format;           ///< text or binary (XRef stream)
+    PDInteger obid;             ///< object containing the section, if binary
+    PDInteger size;             ///< the section's /Size, if binary
+    PDInteger sizeT;            ///< type field width, if binary
+    PDInteger sizeO;            ///< offset field width, if binary
+    PDInteger sizeI;            ///< generation / index field width, if binary
+    PDInteger *ranges;          ///< (first object ID, entry count) pairs, in the order the entries appear
+    PDInteger rangeCount;       ///< number of pairs in ranges
+    PDInteger entries;          ///< total number of entries in all ranges
+    PDStreamFilterRef filter;   ///< initialized filter to apply to raw, or NULL if raw is not compressed
+    unsigned char *raw;         ///< raw entry data, as it appears in the input
+    PDInteger rawLen;           ///< length of raw
+    PDOffset *offs;             ///< decoded offsets
+    PDInteger *gens;            ///< decoded generation numbers / object stream indices
+    PDXType *types;             ///< decoded types
+    PDBool failed;              ///< if set, the section could not be read in its entirety
+};
+
+static void PDXSectionClear(PDXSection S)
+{
+    PDRelease(S->filter);
+    free(S->ranges);
+    free(S->raw);
+    free(S->offs);
+    free(S->gens);
+    free(S->types);
+    memset(S, 0, sizeof(struct PDXSection));
+}
+
+static inline void PDXSectionAddRange(PDXSection S, PDInteger startob, PDInteger count)
+{
+    S->ranges = realloc(S->ranges, (S->rangeCount + 1) * 2 * sizeof(PDInteger));
+    S->ranges[S->rangeCount * 2] = startob;
+    S->ranges[S->rangeCount * 2 + 1] = count;
+    S->rangeCount++;
+    S->entries += count;
+}
+
 void PDXTableDestroy(PDXTableRef xtable)
 {
-    if (xtable->nextOb) free(xtable->nextOb);
+    if (xtable->offsets) free(xtable->offsets);
+    PDXTableSetDecoded(xtable, false);
     PDRelease(xtable->w);
     free(xtable->xrefs);
 }
@@ -237,6 +402,16 @@ PDXTableRef PDXTableCreate(PDXTableRef pdx)
         memcpy(pdxc, pdx, sizeof(struct PDXTable));
         pdxc->xrefs = xrefalloc(pdx, pdx->cap, pdx->width); //malloc(pdx->cap * pdxc->width + 1);
         memcpy(pdxc->xrefs, pdx->xrefs, pdx->cap * pdxc->width);
+        pdxc->offsets = NULL;
+        pdxc->offsetCount = 0;
+        if (pdx->decOffs) {
+            pdxc->decOffs = malloc((pdx->cap + 1) * sizeof(PDOffset));
+            pdxc->decGens = malloc((pdx->cap + 1) * sizeof(PDInteger));
+            pdxc->decTypes = malloc(pdx->cap + 1);
+            memcpy(pdxc->decOffs, pdx->decOffs, pdx->cap * sizeof(PDOffset));
+            memcpy(pdxc->decGens, pdx->decGens, pdx->cap * sizeof(PDInteger));
+            memcpy(pdxc->decTypes, pdx->decTypes, pdx->cap);
+        }
         return pdxc;
     } 
     
@@ -306,6 +481,9 @@ PDBool PDXTableInsertXRefStream(PDParserRef parser)
     PDXTableSetOffsetForID(mxt, trailer->obid, (PDOffset)parser->oboffset);
     PDXTableSetTypeForID(mxt, trailer->obid, PDXTypeUsed);
     
+    // with packing, the table is trimmed down now that the last offset is known
+    if (parser->packing) PDXTableSetMinimalSizes(mxt);
+    
     PDDictionaryRef tobd = PDObjectGetDictionary(trailer);
     PDDictionarySet(tobd, "Size", PDNumberWithSize(mxt->count));
     PDDictionarySet(tobd, "W", PDXTableWEntry(mxt));
@@ -333,8 +511,138 @@ PDBool PDXTableInsertXRefStream(PDParserRef parser)
     return true;
 }
 
+// fetch the (sorted) IDs of the objects in the incremental update section; freed objects have their generation bumped, as per the spec, and are unlinked from the free list (offset 0)
+static inline PDInteger PDXTableGetUpdatedIDs(PDParserRef parser, PDInteger **ids)
+{
+    PDXTableRef mxt = parser->mxt;
+    PDInteger count = PDSplayTreeGetCount(parser->updT);
+    PDInteger genCap = mxt->format == PDXTableFormatText ? 65535 : (1 << (mxt->genSize << 3)) - 1;
+    PDInteger gen;
+    
+    *ids = malloc(sizeof(PDInteger) * (count + 1));
+    count = PDSplayTreePopulateKeys(parser->updT, *ids);
+    
+    for (PDInteger i = 0; i < count; i++) {
+        if (PDXTableIsIDFree(mxt, (*ids)[i])) {
+            PDXTableSetOffsetForID(mxt, (*ids)[i], 0);
+            gen = PDXTableGetGenForID(mxt, (*ids)[i]);
+            if (gen < genCap) PDXTableSetGenForID(mxt, (*ids)[i], gen + 1);
+        }
+    }
+    
+    return count;
+}
+
+// set up the trailer dictionary for an incremental update section
+static inline PDDictionaryRef PDXTableUpdateTrailerDictionary(PDParserRef parser)
+{
+    PDDictionaryRef tobd = PDObjectGetDictionary(parser->trailer);
+    PDDictionarySet(tobd, "Size", PDNumberWithSize(parser->mxt->count));
+    PDDictionarySet(tobd, "Prev", PDNumberWithSize(parser->startxref));
+    PDDictionaryDelete(tobd, "XRefStm");
+    return tobd;
+}
+
+PDBool PDXTableInsertXRefUpdate(PDParserRef parser)
+{
+    char *obuf = malloc(512);
+    PDInteger len;
+    PDInteger i, j, k;
+    PDTwinStreamRef stream = parser->stream;
+    PDXTableRef mxt = parser->mxt;
+    PDInteger *ids;
+    PDInteger count = PDXTableGetUpdatedIDs(parser, &ids);
+    
+    twinstream_printf("xref\n");
+    
+    // each run of consecutive IDs makes up one subsection
+    for (i = 0; i < count; i = j) {
+        for (j = i + 1; j < count && ids[j] == ids[j-1] + 1; j++) ;
+        twinstream_printf("%ld %ld\n", ids[i], j - i);
+        for (k = i; k < j; k++) {
+            twinstream_printf("%010lld %05ld %c \n", PDXTableGetOffsetForID(mxt, ids[k]), PDXTableGetGenForID(mxt, ids[k]), PDXTableIsIDFree(mxt, ids[k]) ? 'f' : 'n');
+        }
+    }
+    
+    free(ids);
+    
+    PDXTableUpdateTrailerDictionary(parser);
+    
+    char *string = NULL;
+    len = PDObjectGenerateDefinition(parser->trailer, &string, 0);
+    // overwrite "0 0 obj" 
+    //      with "trailer"
+    memcpy(string, "trailer", 7);
+    PDTwinStreamInsertContent(stream, len, string); 
+    free(string);
+    
+    free(obuf);
+    
+    return true;
+}
+
+PDBool PDXTableInsertXRefStreamUpdate(PDParserRef parser)
+{
+    PDObjectRef trailer = parser->trailer;
+    PDXTableRef mxt = parser->mxt;
+    PDInteger *ids;
+    PDInteger count;
+    PDInteger i, j;
+    
+    // the xref stream is itself part of the update section; it gets a brand new ID, as the original xref stream remains in place as the /Prev section
+    trailer->obid = mxt->count;
+    if (mxt->count == mxt->cap) PDXTableGrow(mxt, mxt->cap + 1);
+    mxt->count++;
+    PDXTableSetOffsetForID(mxt, trailer->obid, (PDOffset)PDTwinStreamGetOutputOffset(parser->stream));
+    PDXTableSetTypeForID(mxt, trailer->obid, PDXTypeUsed);
+    PDXTableSetGenForID(mxt, trailer->obid, 0);
+    PDSplayTreeInsert(parser->updT, trailer->obid, (void *)trailer->obid);
+    
+    count = PDXTableGetUpdatedIDs(parser, &ids);
+    
+    // pack the entries of the update section, and describe its subsections in /Index
+    char *rows = malloc(mxt->width * count);
+    PDArrayRef index = PDArrayCreateWithCapacity(2);
+    for (i = 0; i < count; i = j) {
+        for (j = i + 1; j < count && ids[j] == ids[j-1] + 1; j++) ;
+        PDArrayAppend(index, PDNumberWithInteger(ids[i]));
+        PDArrayAppend(index, PDNumberWithInteger(j - i));
+    }
+    for (i = 0; i < count; i++) {
+        memcpy(&rows[i * mxt->width], &mxt->xrefs[ids[i] * mxt->width], mxt->width);
+    }
+    free(ids);
+    
+    PDDictionaryRef tobd = PDXTableUpdateTrailerDictionary(parser);
+    PDDictionarySet(tobd, "W", PDXTableWEntry(mxt));
+    PDDictionarySet(tobd, "Index", index);
+    PDRelease(index);
+    
+    // override filters/decode params always -- better than risk passing something on by mistake that makes the xref stream unreadable
+    PDObjectSetFlateDecodedFlag(trailer, true);
+    PDObjectSetPredictionStrategy(trailer, PDPredictorPNG_UP, mxt->width);
+    
+    PDObjectSetStreamFiltered(trailer, rows, mxt->width * count, true, true);
+    
+    // now chuck this through via parser
+    parser->state = PDParserStateBase;
+    parser->obid = trailer->obid;
+    parser->genid = trailer->genid = 0;
+    parser->construct = PDRetain(trailer);
+    
+    PDParserPassthroughObject(parser);
+    
+    return true;
+}
+
 PDBool PDXTableInsert(PDParserRef parser)
 {
+    if (parser->updT) {
+        return (parser->mxt->format == PDXTableFormatText 
+                ? PDXTableInsertXRefUpdate(parser)
+                : PDXTableInsertXRefStreamUpdate(parser));
+    }
+    
     if (parser->mxt->format == PDXTableFormatText) {
         return PDXTableInsertXRef(parser);
     } else {
@@ -426,7 +734,8 @@ static inline PDBool PDXTableFindStartXRef(PDXI X)
     // this stack should start out with "xref" indicating the ob type
     pd_stack_assert_expected_key(&X->stack, "startxref");
     // next is the offset 
-    pd_stack_push_identifier(&X->queue, (PDID)pd_stack_pop_size(&X->stack));
+    X->parser->startxref = pd_stack_pop_size(&X->stack);
+    pd_stack_push_identifier(&X->queue, (PDID)X->parser->startxref);
     PDAssert(X->stack == NULL);
     PDRelease(xrefScanner);
     
@@ -463,46 +772,21 @@ static inline PDBool PDXTableReadXRefStreamHeader(PDXI X)
     return true;
 }
 
-static inline PDBool PDXTableReadXRefStreamContent(PDXI X, PDOffset offset)
+static PDBool PDXSectionReadStream(PDXI X, PDXSection S)
 {
-    PDSize size;
-    char *xrefs;
-    char *buf;
-    char *bufi;
-    PDBool aligned;
     PDInteger len;
     PDArrayRef byteWidths;
-//    pd_stack index;
     PDArrayRef index;
     PDDictionaryRef filterOpts;
-    PDInteger startob;
-    PDInteger obcount;
-//    pd_stack filterDef;
     PDStringRef filterName;
-    PDInteger j;
-    PDInteger i;
-    PDInteger indexCtr, indexCount;
-    PDInteger sizeT;
-    PDInteger sizeO;
-    PDInteger sizeI;
-    PDInteger padT = 0;
-    PDInteger padO = 0;
-    PDInteger padI = 0;
-    PDInteger shrT = 0;
-    PDInteger shrO = 0;
-    PDInteger shrI = 0;
-    PDInteger capT = 0;
-    PDInteger capO = 0;
-    PDInteger capI = 0;
-    PDXTableRef pdx;
+    PDInteger i, indexCount;
     
-    pdx = X->pdx;
-    pdx->format = PDXTableFormatBinary;
+    S->format = PDXTableFormatBinary;
     
     // pull in defs stack and get ready to read stream
     PDID id = pd_stack_pop_identifier(&X->stack);
     PDAssert(id == &PD_OBJ);
-    pdx->obid = pd_stack_pop_int(&X->stack);
+    S->obid = pd_stack_pop_int(&X->stack);
     pd_stack_destroy(&X->stack);
     PDScannerPopStack(X->scanner, &X->stack);
     pd_stack s = X->stack;
@@ -511,85 +795,176 @@ static inline PDBool PDXTableReadXRefStreamContent(PDXI X, PDOffset offset)
 
     PDScannerAssertString(X->scanner, "stream");
     len = PDNumberGetInteger(PDDictionaryGet(X->dict, "Length"));
-//    len = PDIntegerFromString(pd_stack_get_dict_key(X->stack, "Length", false)->prev->prev->info);
     byteWidths = PDDictionaryGet(X->dict, "W");
-//    byteWidths = pd_stack_get_dict_key(X->stack, "W", false);
     index = PDDictionaryGet(X->dict, "Index");
-//    index = pd_stack_get_dict_key(X->stack, "Index", false);
-//    filterDef = pd_stack_get_dict_key(X->stack, "Filter", false);
     filterName = PDDictionaryGet(X->dict, "Filter");
-    size = PDNumberGetInteger(PDDictionaryGet(X->dict, "Size"));
-//    size = PDIntegerFromString(pd_stack_get_dict_key(X->stack, "Size", false)->prev->prev->info);
+    S->size = PDNumberGetInteger(PDDictionaryGet(X->dict, "Size"));
     
-    PDStreamFilterRef filter = NULL;
     if (filterName) {
         // ("name"), "filter name"
         filterOpts = PDDictionaryGet(X->dict, "DecodeParms");
-//        filterDef = as(pd_stack, filterDef->prev->prev->info)->prev;
-//        filterOpts = PDDictionaryCreateWithComplex(pd_stack_get_dict_key(X->stack, "DecodeParms", false));
-//        if (filterOpts) 
-//            filterOpts = PDStreamFilterGenerateOptionsFromDictionaryStack(filterOpts->prev->prev->info);
-        filter = PDStreamFilterObtain(PDStringEscapedValue(filterName, false, NULL), true, filterOpts);
-        if (NULL == filter) {
+        S->filter = PDStreamFilterObtain(PDStringEscapedValue(filterName, false, NULL), true, filterOpts);
+        if (NULL == S->filter) {
             PDError("unable to obtain filter %s!", filterName->data);
             PDRelease(filterName->alt);
             filterName->alt = NULL; // get rid of "cached" result
             PDStringEscapedValue(filterName, false, NULL);
+        } else if (! PDStreamFilterInit(S->filter)) {
+            // filters are set up here, as doing so involves the options dictionary, which is not safe to touch from a decoding thread
+            PDError("unable to initialize filter %s!", filterName->data);
+            PDRelease(S->filter);
+            S->filter = NULL;
         }
     }
     
-    if (filter) {
-        /// @todo We know from 'size' exactly how many bytes we expect out of this thing, so we can set buffer to this value instead of basing it off len (compressed stream length)
-        
-        PDInteger got = 0;
-        PDInteger cap = len < 1024 ? 1024 : len * 4;
-        buf = malloc(cap);
+    // the raw content is read as is; inflating it is left to the decoding step
+    S->raw = malloc(len > 0 ? len : 1);
+    S->rawLen = PDScannerReadStream(X->scanner, len, (char *)S->raw, len);
+    if (S->rawLen < 0) S->rawLen = 0;
+    
+    S->sizeT = PDNumberGetInteger(PDArrayGetElement(byteWidths, 0));
+    S->sizeO = PDNumberGetInteger(PDArrayGetElement(byteWidths, 1));
+    S->sizeI = PDNumberGetInteger(PDArrayGetElement(byteWidths, 2));
+    
+    // index, which is optional, can fine tune startob/obcount; it defaults to [0 Size]
+    indexCount = index ? PDArrayGetCount(index) : 0;
+    for (i = 0; i + 1 < indexCount; i += 2) {
+        PDXSectionAddRange(S, PDNumberGetInteger(PDArrayGetElement(index, i)), PDNumberGetInteger(PDArrayGetElement(index, i+1)));
+    }
+    if (S->rangeCount == 0) {
+        PDXSectionAddRange(S, 0, S->size);
+    }
+    
+    PDScannerAssertComplex(X->scanner, PD_ENDSTREAM);
+    PDScannerAssertString(X->scanner, "endobj");
+    
+    return true;
+}
+
+static void PDXSectionDecode(PDXSection S)
+{
+    unsigned char *rows = S->raw;
+    PDInteger rowsLen = S->rawLen;
+    PDInteger width, need, cap, bytes, i, j, k, prevFreeID;
+    
+    width = S->format == PDXTableFormatText ? 20 : S->sizeT + S->sizeO + S->sizeI;
+    need = S->entries * width;
+    
+    if (S->filter) {
+        // we know from the entry count and the field widths how many bytes we expect out of this thing; sizing the buffer up front keeps it from being moved underneath the filter chain mid-read
+        PDStreamFilterRef filter = S->filter;
+        cap = need + 512;
+        if (cap < 1024) cap = 1024;
+        rows = malloc(cap);
+        rowsLen = 0;
         
-        PDScannerAttachFilter(X->scanner, filter);
-        PDInteger bytes = PDScannerReadStream(X->scanner, len, buf, cap);
+        filter->bufIn = S->raw;
+        filter->bufInAvailable = S->rawLen;
+        filter->bufOut = rows;
+        filter->bufOutCapacity = cap;
+        bytes = PDStreamFilterBegin(filter);
         while (bytes > 0) {
-            got += bytes;
-            if (! filter->finished && filter->bufOutCapacity < 512) {
-                cap *= (cap < 8192 ? 4 : 2); // we don't want to hit caps in filters more than once or twice, but we don't want huge buffers either so we cap the rapid growth to 8k and then double after that
-                buf = realloc(buf, cap);
+            rowsLen += bytes;
+            if (! filter->finished && cap - rowsLen < 512) {
+                cap *= 2;
+                rows = realloc(rows, cap);
             }
-            bytes = PDScannerReadStreamNext(X->scanner, &buf[got], cap - got);
+            filter->bufOut = &rows[rowsLen];
+            filter->bufOutCapacity = cap - rowsLen;
+            bytes = PDStreamFilterProceed(filter);
         }
-
-        PDScannerDetachFilter(X->scanner);
-    } else {
-        buf = malloc(len);
-        PDScannerReadStream(X->scanner, len, buf, len);
+        
+        free(S->raw);
+    }
+    S->raw = NULL;
+    
+    // entries beyond the end of the data, if any, end up zeroed, i.e. freed
+    if (rowsLen < need) {
+        rows = realloc(rows, need);
+        memset(&rows[rowsLen], 0, need - rowsLen);
+    }
+    
+    S->offs = malloc((S->entries + 1) * sizeof(PDOffset));
+    S->gens = malloc((S->entries + 1) * sizeof(PDInteger));
+    S->types = malloc(S->entries + 1);
+    
+    if (S->format == PDXTableFormatBinary) {
+        // the ranges follow each other in the data, so they are decoded in one go
+        PDXDecodeStreamEntries(rows, S->entries, S->sizeT, S->sizeO, S->sizeI, S->offs, S->gens, S->types);
+        free(rows);
+        return;
     }
     
-    // process buf
+    PDXDecodeTextEntries((char *)rows, S->entries, S->offs, S->gens, S->types);
+    free(rows);
+    
+    for (k = j = 0; j < S->rangeCount; j++) {
+        prevFreeID = -1;
+        for (i = 0; i < S->ranges[j * 2 + 1]; i++, k++) {
+            // some PDF creators (determine who this is so they can be contacted; or determine if this is acceptable according to spec) incorrectly think setting generation number to 65536 is the same as setting the used character to 'f' (free) -- in order to not confuse Pajdeg, we address that here
+            // other PDF creators think dumping 000000000 00000 n (i.e. this object can be found at offset 0, and it's in use) means "this object is unused"; we address that as well
+            if (S->types[k] == PDXTypeUsed && S->gens[k] != 65536 && S->offs[k] != 0) continue;
+#ifdef DEBUG
+            if (S->types[k] == PDXTypeUsed) {
+                PDNotice("warning: marking object #%ld as unused (gen = 65536 or offs = 0)", S->ranges[j * 2] + i);
+            }
+#endif
+            // freed objects link to each other in obstreams
+            S->types[k] = PDXTypeFreed;
+            if (prevFreeID > -1)
+                S->gens[prevFreeID] = S->ranges[j * 2] + i;
+            prevFreeID = k;
+            S->gens[k] = 0;
+        }
+    }
+}
+
+#define PDX_DECODE_THREAD_BYTES 65536   // minimum number of raw bytes per additional decoding thread
+
+static void PDXSectionDecodeJob(void *info, PDInteger index)
+{
+    PDXSection S = &((PDXSection)info)[index];
+    if (S->raw) PDXSectionDecode(S);
+}
+
+/**
+ Decode the given sections, in parallel if there is enough data to make it worthwhile. The calling thread takes part in the decoding, and returns once all sections are decoded.
+ 
+ Decoding only touches the section itself; in particular, no pd_stack or dictionary operations take place, as neither is thread safe.
+ */
+static void PDXSectionDecodeAll(PDXSection sections, PDInteger count)
+{
+    PDInteger bytes = 0;
+    for (PDInteger i = 0; i < count; i++) bytes += sections[i].rawLen;
+    pd_work_queue_run(PDXSectionDecodeJob, sections, count, bytes, PDX_DECODE_THREAD_BYTES);
+}
+
+static void PDXSectionApplyStream(PDXI X, PDXTableRef pdx, PDXSection S)
+{
+    PDInteger i, k, startob, obcount;
+    PDInteger size = S->size;
     
-//    byteWidths = as(pd_stack, byteWidths->prev->prev->info)->prev->prev->info;
-    sizeT = PDNumberGetInteger(PDArrayGetElement(byteWidths, 0)); // PDIntegerFromString(as(pd_stack, byteWidths->info)->prev->info);
-    sizeO = PDNumberGetInteger(PDArrayGetElement(byteWidths, 1)); // PDIntegerFromString(as(pd_stack, byteWidths->prev->info)->prev->info);
-    sizeI = PDNumberGetInteger(PDArrayGetElement(byteWidths, 2)); //PDIntegerFromString(as(pd_stack, byteWidths->prev->prev->info)->prev->info);
+    pdx->format = PDXTableFormatBinary;
+    pdx->obid = S->obid;
     
-    if (pdx->count == 0 || (sizeT >= pdx->typeSize && sizeO >= pdx->offsSize && sizeI >= pdx->genSize)) {
+    if (pdx->count == 0 || (S->sizeT >= pdx->typeSize && S->sizeO >= pdx->offsSize && S->sizeI >= pdx->genSize)) {
         // we can adopt the given sizes as is, as they won't force us to lose bytes
-        PDXTableSetSizes(pdx, sizeT > 0 ? sizeT : 1, sizeO, sizeI);
-        aligned = sizeT > 0;
+        PDXTableSetSizes(pdx, S->sizeT > 0 ? S->sizeT : 1, S->sizeO, S->sizeI);
     } else {
         // we may still have to resize the table to fit
-        unsigned char maxT = sizeT > pdx->typeSize ? sizeT : pdx->typeSize;
-        unsigned char maxO = sizeO > pdx->offsSize ? sizeO : pdx->offsSize;
-        unsigned char maxI = sizeI > pdx->genSize  ? sizeI : pdx->genSize;
+        unsigned char maxT = S->sizeT > pdx->typeSize ? S->sizeT : pdx->typeSize;
+        unsigned char maxO = S->sizeO > pdx->offsSize ? S->sizeO : pdx->offsSize;
+        unsigned char maxI = S->sizeI > pdx->genSize  ? S->sizeI : pdx->genSize;
         if (maxT > pdx->typeSize || maxO > pdx->offsSize || maxI > pdx->genSize) {
             PDXTableSetSizes(pdx, maxT, maxO, maxI);
         }
-        aligned = false;
     }
     
     if (size == X->mtobid) {
         // some PDF creators think it's wise to exclude the XRef binary object from the XRef. entirely. this can be signified by the XRef being the very last object in the PDF, and the XRef size being its own id (thus including all except itself)
         if (size >= pdx->cap) {
             // realloc; we only do this here because we want to avoid two big reallocs (one for 'size' and one for 'size+1')
-            pdx->cap = size+1;
-            pdx->xrefs = xrefrealloc(pdx, pdx->xrefs, size + 1, pdx->width); //realloc(pdx->xrefs, pdx->width * (size + 1));
+            PDXTableGrow(pdx, size + 1);
         }
     }
     
@@ -597,147 +972,42 @@ static inline PDBool PDXTableReadXRefStreamContent(PDXI X, PDOffset offset)
         pdx->count = size;
         if (size > pdx->cap) {
             /// @todo this size is known beforehand, or can be known beforehand, in pass 1; xrefs should never have to be reallocated, except for the initial setup
-            pdx->cap = size;
-            pdx->xrefs = xrefrealloc(pdx, pdx->xrefs, size, pdx->width); //realloc(pdx->xrefs, pdx->width * size);
+            PDXTableGrow(pdx, size);
         }
     }
     
-//    // this layout may be optimized for Pajdeg; if it is, we can inject the buffer straight into the data structure
-//    aligned = sizeT == PDXTypeSize && sizeO == PDXOffsSize && sizeI == PDXGenSize;
-//    
-    if (! aligned) {
-        // not aligned, so need pad
-#define setup_align(suf, our_size) \
-        if (our_size > size##suf) { \
-            cap##suf = size##suf; \
-            pad##suf = our_size - size##suf; \
-            shr##suf = 0; \
-        } else { \
-            cap##suf = our_size; \
-            pad##suf = 0; \
-            shr##suf = size##suf - our_size; \
+    for (i = k = 0; i < S->rangeCount; i++) {
+        startob = S->ranges[i * 2];
+        obcount = S->ranges[i * 2 + 1];
+        PDAssert(startob >= 0 && startob + obcount <= size);
+        if (startob >= 0 && obcount > 0 && startob + obcount <= pdx->cap) {
+            PDXTableSetEntries(pdx, startob, obcount, &S->offs[k], &S->gens[k], &S->types[k]);
         }
-
-        setup_align(T, pdx->typeSize);
-        setup_align(O, pdx->offsSize);
-        setup_align(I, pdx->genSize);
-        
-#undef setup_align
-#define transfer_pc(dst, src, pad, shr, cap, i) \
-            for (i = 0; i < pad; i++) \
-                dst[i] = 0; \
-            for (i = 0; i < shr; i++) \
-                PDAssert(src[i] == 0); \
-            memcpy(&dst[pad], &src[shr], cap); \
-            dst += pad + cap; \
-            src += shr + cap
-#define transfer_pcs(dst, src, i, suf) transfer_pc(dst, src, pad##suf, shr##suf, cap##suf, i)
-    }
-    
-    // index, which is optional, can fine tune startob/obcount; it defaults to [0 Size]
-
-#define index_pop() \
-        startob = PDNumberGetInteger(PDArrayGetElement(index, indexCtr));\
-        obcount = PDNumberGetInteger(PDArrayGetElement(index, indexCtr+1));\
-        indexCtr += 2
-//    startob = PDIntegerFromString(as(pd_stack, index->info)->prev->info); \
-//    obcount = PDIntegerFromString(as(pd_stack, index->prev->info)->prev->info); \
-//    index = index->prev->prev
-    
-    startob = 0;
-    obcount = size;
-    indexCtr = 0;
-    indexCount = index ? PDArrayGetCount(index) : 0;
-
-    if (indexCtr < indexCount) {
-//        // move beyond header
-//        index = as(pd_stack, index->prev->prev->info)->prev->prev->info;
-//        // some crazy PDF creators out there may think it's a lovely idea to put an empty index in; if they do, we will presume they meant the default [0 Size]
-//        if (index) {
-        index_pop();
-//        }
+        k += obcount;
     }
     
-    xrefs = pdx->xrefs;
-    bufi = buf;
-    
-    do {
-        PDAssert(startob + obcount <= size);
-        
-        if (aligned) {
-            memcpy(&xrefs[startob * pdx->width], bufi, obcount * pdx->width);
-            bufi += obcount * pdx->width;
-        } else {
-            char *dst = &xrefs[startob * pdx->width];
-            
-            for (i = 0; i < obcount; i++) {
-                // transfer 
-                transfer_pcs(dst, bufi, j, T);
-                if (sizeT == 0) dst[-1] = PDXTypeUsed;
-                transfer_pcs(dst, bufi, j, O);
-                transfer_pcs(dst, bufi, j, I);
-                PDAssert(((dst - xrefs) % pdx->width) == 0);
-            }
-        }
-        
-        obcount = 0;
-        if (indexCtr < indexCount) {
-            index_pop();
-        }
-    } while (obcount > 0);
-    
-#undef transfer_pcs
-#undef transfer_pc
-#undef index_pop
-    
-    free(buf);
-    
-    // 01 0E8A 0    % entry for object 2 (0x0E8A = 3722)
-    // 02 0002 00   % entry for object 3 (in object stream 2, index 0)
-    
-    // Index defines what we've got 
-    /*
-     stack<0xb648ae0> {
-         0x46d0b0 ("de")
-         Index
-         stack<0x172aef60> {
-             0x46d0b4 ("array")
-             0x46d0a8 ("entries")
-             stack<0x172adff0> {
-                 stack<0x172adfe0> {
-                     0x46d0b8 ("ae")
-                     1636
-                 }
-                 stack<0x172ae000> {
-                     0x46d0b8 ("ae")
-                     1
-                 }
-                 stack<0x172ae070> {
-                     0x46d0b8 ("ae")
-                     1660
-                 }
-                 stack<0x172ae0c0> {
-                     0x46d0b8 ("ae")
-                     1
-                 }
-                 stack<0x172ae160> {
-                     0x46d0b8 ("ae")
-                     1663
-                 }
-     */
-    
-    PDScannerAssertComplex(X->scanner, PD_ENDSTREAM);
-    PDScannerAssertString(X->scanner, "endobj");
-    
     if (size == X->mtobid && pdx->count == size) {
         // put in the XRef manually
         pdx->count++;
         PDXTableSetTypeForID(pdx, X->mtobid, PDXTypeUsed);
-        PDXTableSetOffsetForID(pdx, X->mtobid, (PDOffset)offset);
+        PDXTableSetOffsetForID(pdx, X->mtobid, S->pos);
         PDXTableSetGenForID(pdx, X->mtobid, 0);
     }
-    
-    return true;
+}
+
+static inline PDBool PDXTableReadXRefStreamContent(PDXI X, PDOffset offset)
+{
+    struct PDXSection S;
+    memset(&S, 0, sizeof(struct PDXSection));
+    S.pos = offset;
+    
+    PDBool success = PDXSectionReadStream(X, &S);
+    if (success) {
+        PDXSectionDecode(&S);
+        PDXSectionApplyStream(X, X->pdx, &S);
+    }
+    PDXSectionClear(&S);
+    return success;
 }
 
 static inline PDBool PDXTableReadXRefHeader(PDXI X)
@@ -769,21 +1039,11 @@ static inline PDBool PDXTableReadXRefHeader(PDXI X)
     return true;
 }
 
-static inline PDBool PDXTableReadXRefContent(PDXI X)
+static PDBool PDXSectionReadText(PDXI X, PDXSection S)
 {
-    PDSize size;
-    PDInteger i;
-    char *buf;
-    char *src;
-    char *dst;
-    PDBool used;
-    PDOffset offset;
-//    PDInteger *freeLink;
-    PDInteger prevFreeID;
-
-    PDXTableRef pdx = X->pdx;
-    pdx->format = PDXTableFormatText;
-    PDXTableSetSizes(pdx, 1, 4, 2); // we do this because there's no guarantee that 0 <= generation number <= 255, which it must be for the default size setup
+    PDInteger bytes, got;
+    
+    S->format = PDXTableFormatText;
     
     do {
         // this stack = xref, startobid, <startobid>, count, <count>
@@ -793,66 +1053,52 @@ static inline PDBool PDXTableReadXRefContent(PDXI X)
         
         //printf("[%d .. %d]\n", startobid, startobid + count - 1);
         
+        if (count < 0) {
+            S->failed = true;
+            return false;
+        }
+        
+        // we now have a stream (technically speaking) of xrefs
+        bytes = count * 20;
+        S->raw = realloc(S->raw, S->rawLen + bytes + 1);
+        got = PDScannerReadStream(X->scanner, bytes, (char *)&S->raw[S->rawLen], bytes);
+        if (bytes != got) {
+            S->failed = true;
+            return false;
+        }
+        S->rawLen += bytes;
+        PDXSectionAddRange(S, startobid, count);
+    } while (PDScannerPopStack(X->scanner, &X->stack));
+    
+    return true;
+}
+
+static void PDXSectionApplyText(PDXI X, PDXTableRef pdx, PDXSection S)
+{
+    PDInteger i, k, startobid, count;
+    PDSize size;
+    
+    pdx->format = PDXTableFormatText;
+    PDXTableSetSizes(pdx, 1, 4, 2); // we do this because there's no guarantee that 0 <= generation number <= 255, which it must be for the default size setup
+    
+    for (i = k = 0; i < S->rangeCount; i++) {
+        startobid = S->ranges[i * 2];
+        count = S->ranges[i * 2 + 1];
         size = startobid + count;
         
         if (size > pdx->count) {
             pdx->count = size;
             if (size > pdx->cap) {
                 // we must realloc xref as it can't contain all the xrefs
-                pdx->cap = size;
-                pdx->xrefs = xrefrealloc(pdx, pdx->xrefs, size, pdx->width); //realloc(pdx->xrefs, pdx->width * size);
+                PDXTableGrow(pdx, size);
             }
         }
         
-        // we now have a stream (technically speaking) of xrefs
-        PDInteger bytes = count * 20;
-        buf = malloc(bytes);
-        if (bytes != PDScannerReadStream(X->scanner, bytes, buf, bytes)) {
-            free(buf);
-            return false;
-        }
-        
-        // convert into internal xref table
-        src = buf;
-        dst = &pdx->xrefs[pdx->width * startobid];
-        prevFreeID = -1;
-        for (i = 0; i < count; i++) {
-#define PDXOffset(pdx)      fast_mutative_atol(pdx, 10)
-#define PDXGenId(pdx)       fast_mutative_atol(&pdx[11], 5)
-#define PDXUsed(pdx)        (pdx[17] == 'n')
-            
-            offset = (PDOffset)PDXOffset(src);
-            
-            // some PDF creators (determine who this is so they can be contacted; or determine if this is acceptable according to spec) incorrectly think setting generation number to 65536 is the same as setting the used character to 'f' (free) -- in order to not confuse Pajdeg, we address that here
-            // other PDF creators think dumping 000000000 00000 n (i.e. this object can be found at offset 0, and it's in use) means "this object is unused"; we address that as well
-#ifdef DEBUG
-            if (PDXUsed(src) && (PDXGenId(src) == 65536 || offset == 0)) {
-                PDNotice("warning: marking object #%ld as unused (gen = 65536 or offs = 0)", i);
-            }
-#endif
-            used = PDXUsed(src) && (PDXGenId(src) != 65536) && (offset != 0);
-            
-            _PDXSetOffsetForID(dst, pdx, i, offset);
-
-            if (used) {
-                _PDXSetTypeForID(dst, pdx, i, PDXTypeUsed);
-                _PDXSetGenForID(dst, pdx, i, PDXGenId(src));
-            } else {
-                // freed objects link to each other in obstreams
-                _PDXSetTypeForID(dst, pdx, i, PDXTypeFreed);
-                if (prevFreeID > -1)
-                    _PDXSetGenForID(dst, pdx, prevFreeID, startobid + i);
-                prevFreeID = i;
-                _PDXSetGenForID(dst, pdx, prevFreeID, 0);
-            }
-            
-            src += 20;
+        if (startobid >= 0 && count > 0) {
+            PDXTableSetEntries(pdx, startobid, count, &S->offs[k], &S->gens[k], &S->types[k]);
         }
-        
-        free(buf);
-    } while (PDScannerPopStack(X->scanner, &X->stack));
-    
-    return true;
+        k += count;
+    }
 }
 
 static inline void PDXTableParseTrailer(PDXI X)
@@ -975,22 +1221,61 @@ PDBool PDXTableFetchContent(PDXI X)
     pd_stack osstack;
     PDXTableRef prev;
     PDXTableRef pdx;
+    PDXSection sections;
+    PDXSection S;
     
     // fetch headers puts offset stack into X as stack so we get that out
     osstack = X->stack;
     X->stack = NULL;
     
-    // we now have a stack in versioned order, so we start setting up xrefs
+    // read the sections in versioned order; they all share the input stream, so this is done one at a time
+    sections = calloc(X->tables + 1, sizeof(struct PDXSection));
+    gotTables = 0;
+    while (0 != (offs = (PDSize)pd_stack_pop_identifier(&osstack))) {
+        S = &sections[gotTables++];
+        S->pos = (PDOffset)offs;
+        
+        // jump to xref
+        PDTwinStreamSeek(X->stream, offs);
+        
+        // set up scanner
+        X->scanner = PDTwinStreamCreateScanner(X->parser->stream, pdfRoot);
+        //PDScannerCreateWithState(pdfRoot);
+        
+        // if this is a v1.5 PDF, we may run into an object definition here; the object is the replacement for the trailer, and has a (usually compressed) stream of the XREF table
+        if (PDScannerPopStack(X->scanner, &X->stack)) {
+            // we determine this by checking the identifier for the popped stack
+            if (PDIdentifies(X->stack->info, PD_OBJ)) {
+                if (! PDXSectionReadStream(X, S)) {
+                    PDWarn("Failed to read XRef stream header.");
+                }
+            } else {
+                // this is a regular old xref table with a trailer at the end
+                if (! PDXSectionReadText(X, S)) {
+                    PDWarn("Failed to read XRef header.");
+                }
+            }
+        }
+        
+        PDRelease(X->scanner);
+        pd_stack_destroy(&X->stack);
+    }
+    X->scanner = NULL;
+    
+    // decoding (and inflating) is independent for every section, so it is spread out over worker threads
+    PDXSectionDecodeAll(sections, gotTables);
+    
+    // we now have the sections in versioned order, so we start setting up xrefs; every table is a copy of its predecessor, with the section's entries applied on top, so that the newest entry for an object wins
     offsets = malloc(X->tables * sizeof(PDSize));
     tables = malloc(X->tables * sizeof(PDXTableRef));
     offscount = 0;
-    gotTables = 0;
     
     pdx = NULL;
-    while (0 != (offs = (PDSize)pd_stack_pop_identifier(&osstack))) {
-        gotTables++;
+    for (S = sections; S < &sections[gotTables]; S++) {
+        offs = (PDSize)S->pos;
         prev = pdx;
         pdx = PDXTableCreate(pdx);
+        PDXTableSetDecoded(pdx, true);
         
         pdx->prev = prev;
         X->pdx = pdx;
@@ -1007,33 +1292,17 @@ PDBool PDXTableFetchContent(PDXI X)
         
         pdx->pos = offs;
         
-        // jump to xref
-        PDTwinStreamSeek(X->stream, offs);
-        
-        // set up scanner
-        X->scanner = PDTwinStreamCreateScanner(X->parser->stream, pdfRoot);
-        //PDScannerCreateWithState(pdfRoot);
-        
-        // if this is a v1.5 PDF, we may run into an object definition here; the object is the replacement for the trailer, and has a (usually compressed) stream of the XREF table
-        if (PDScannerPopStack(X->scanner, &X->stack)) {
-            // we determine this by checking the identifier for the popped stack
-            if (PDIdentifies(X->stack->info, PD_OBJ)) {
-                if (! PDXTableReadXRefStreamContent(X, offs)) {
-                    PDWarn("Failed to read XRef stream header.");
-                    continue;
-                }
+        if (S->offs) {
+            if (S->format == PDXTableFormatBinary) {
+                PDXSectionApplyStream(X, pdx, S);
             } else {
-                // this is a regular old xref table with a trailer at the end
-                if (! PDXTableReadXRefContent(X)) {
-                    PDWarn("Failed to read XRef header.");
-                    continue;
-                }
+                PDXSectionApplyText(X, pdx, S);
             }
         }
         
-        PDRelease(X->scanner);
-        pd_stack_destroy(&X->stack);
+        PDXSectionClear(S);
     }
+    free(sections);
     
     // pdx is now the complete input xref table with all offsets correct, so we use it as the base for the master table
     X->parser->mxt = PDXTableCreate(pdx);
@@ -1064,6 +1333,15 @@ PDBool PDXTableFetchContent(PDXI X)
             }
         }
     }
+
+    // objects run up to the next object, XRef section, or the end of the input; knowing all of these up front means every object can be read in one go
+    PDOffset *boundaries = malloc((offscount + 1) * sizeof(PDOffset));
+    for (i = 0; i < offscount; i++) boundaries[i] = (PDOffset)offsets[i];
+    PDSize inputSize = PDTwinStreamGetInputSize(X->parser->stream);
+    if (inputSize) boundaries[offscount++] = (PDOffset)inputSize;
+    PDXTableBuildOffsetIndex(X->parser->mxt, boundaries, offscount);
+    free(boundaries);
+    
     free(offsets);
     free(tables);
     
@@ -1151,6 +1429,482 @@ PDBool PDXTableFetchXRefs(PDParserRef parser)
     return true;
 }
 
+//
+// XRef reconstruction
+//
+
+#define PDX_SWEEP_CHUNK     1048576 // bytes swept per read, for inputs that are not memory mapped
+#define PDX_SWEEP_MAPPED    262144  // bytes swept at a time, for memory mapped inputs; small enough for the chunk to stay in cache across the keyword passes
+#define PDX_SWEEP_BEHIND    64      // bytes kept from the preceding chunk, so that the numbers in front of an "obj" keyword can be read
+#define PDX_SWEEP_AHEAD     16      // bytes read past the chunk, so that the character following a keyword can be checked
+#define PDX_SWEEP_MAXOBID   8388607 // the largest object number permitted in a PDF (PDF 1.7, Appendix C)
+
+#define PDXSweepIsRegular(c)    (PDOperatorSymbolGlob[(unsigned char)(c)] == PDOperatorSymbolGlobRegular)
+#define PDXSweepIsWhitespace(c) (PDOperatorSymbolGlob[(unsigned char)(c)] == PDOperatorSymbolGlobWhitespace)
+#define PDXSweepIsDigit(c)      ((c) >= '0' && (c) <= '9')
+
+/**
+ An object definition ("N G obj") encountered during a sweep.
+ */
+typedef struct PDXSweepObject {
+    PDInteger obid;         ///< object id
+    PDInteger genid;        ///< generation number
+    PDOffset  offset;       ///< input offset of the object id
+} PDXSweepObject;
+
+/**
+ A trailer dictionary or XRef stream encountered during a sweep.
+ */
+typedef struct PDXSweepTrailer {
+    PDOffset  offset;       ///< input offset of the "trailer" keyword, or of the XRef stream object
+    PDBool    stream;       ///< whether this is an XRef stream
+} PDXSweepTrailer;
+
+typedef struct PDXSweep *PDXSweep;
+
+/**
+ Sweep state.
+ */
+struct PDXSweep {
+    PDXSweepObject  *obs;           ///< object definitions, in input order
+    PDInteger        obcount;       ///< number of object definitions
+    PDInteger        obcap;         ///< capacity of obs
+    PDXSweepTrailer *trailers;      ///< trailers and XRef streams, in input order
+    PDInteger        trailercount;  ///< number of trailers
+    PDInteger        trailercap;    ///< capacity of trailers
+    PDInteger       *objstms;       ///< indices in obs of objects with an /ObjStm name in them, in input order
+    PDInteger        objstmcount;   ///< number of object streams
+    PDInteger        objstmcap;     ///< capacity of objstms
+    PDInteger        catalog;       ///< index in obs of the last object with a /Catalog name in it, or -1
+    PDInteger        maxobid;       ///< highest object id encountered
+};
+
+// index of the last object definition preceding offset, or -1
+static inline PDInteger PDXSweepEnclosingObject(PDXSweep S, PDOffset offset)
+{
+    PDInteger lo = 0;
+    PDInteger hi = S->obcount;
+    PDInteger mid;
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (S->obs[mid].offset < offset) lo = mid + 1; else hi = mid;
+    }
+    return lo - 1;
+}
+
+static inline void PDXSweepAddTrailer(PDXSweep S, PDOffset offset, PDBool stream)
+{
+    if (S->trailercount == S->trailercap) {
+        S->trailercap = S->trailercap ? S->trailercap * 2 : 8;
+        S->trailers = realloc(S->trailers, S->trailercap * sizeof(PDXSweepTrailer));
+    }
+    S->trailers[S->trailercount++] = (PDXSweepTrailer) {offset, stream};
+}
+
+// read the number ending right before buf[*k], moving *k to its first digit
+static inline PDBool PDXSweepNumberBefore(const char *buf, PDSize *k, PDInteger *value)
+{
+    PDSize e = *k;
+    PDSize b = e;
+    PDInteger v = 0;
+    while (b > 0 && e - b < 10 && PDXSweepIsDigit(buf[b-1])) b--;
+    if (b == e) return false;
+    for (*k = b; b < e; b++) v = v * 10 + buf[b] - '0';
+    *value = v;
+    return true;
+}
+
+// find the next occurrence of a keyword starting in [*i, to) that is followed by a non-regular character; eof indicates whether the buffer ends where the input does
+static inline PDBool PDXSweepFind(const char *buf, PDSize len, PDSize to, PDBool eof, PDSize *i, const char *kw, PDSize kwlen)
+{
+    PDSize lim = to + kwlen - 1 < len ? to + kwlen - 1 : len;
+    const char *p;
+    PDSize s;
+    
+    while (*i + kwlen <= lim) {
+        p = kwlen == 3 ? memchr(&buf[*i + 2], kw[2], lim - *i - 2) : memmem(&buf[*i], lim - *i, kw, kwlen);
+        if (p == NULL) break;
+        s = p - buf - (kwlen == 3 ? 2 : 0);
+        *i = s + 1;
+        if (memcmp(&buf[s], kw, kwlen)) continue;
+        if (s + kwlen < len ? ! PDXSweepIsRegular(buf[s + kwlen]) : eof) {
+            *i = s;
+            return true;
+        }
+    }
+    *i = lim;
+    return false;
+}
+
+// sweep buf, which holds the input from offset base and on, for keywords starting in [from, to)
+static void PDXSweepChunk(PDXSweep S, const char *buf, PDSize len, PDOffset base, PDSize from, PDSize to, PDBool eof)
+{
+    PDInteger obid, genid, ob;
+    PDSize i, k;
+    
+    // "<obid> <genid> obj"; as 'j' is rare in PDF syntax, the keyword is located via its last character
+    for (i = from; PDXSweepFind(buf, len, to, eof, &i, "obj", 3); i++) {
+        k = i;
+        if (k == 0 || ! PDXSweepIsWhitespace(buf[k-1])) continue;
+        while (k > 0 && PDXSweepIsWhitespace(buf[k-1])) k--;
+        if (! PDXSweepNumberBefore(buf, &k, &genid)) continue;
+        if (k == 0 || ! PDXSweepIsWhitespace(buf[k-1])) continue;
+        while (k > 0 && PDXSweepIsWhitespace(buf[k-1])) k--;
+        if (! PDXSweepNumberBefore(buf, &k, &obid)) continue;
+        if (k > 0 ? PDXSweepIsRegular(buf[k-1]) : base != 0) continue;
+        if (obid == 0 || obid > PDX_SWEEP_MAXOBID || genid > 65535) continue;
+        
+        if (S->obcount == S->obcap) {
+            S->obcap = S->obcap ? S->obcap * 2 : 1024;
+            S->obs = realloc(S->obs, S->obcap * sizeof(PDXSweepObject));
+        }
+        S->obs[S->obcount++] = (PDXSweepObject) {obid, genid, base + (PDOffset)k};
+        if (obid > S->maxobid) S->maxobid = obid;
+    }
+    
+    for (i = from; PDXSweepFind(buf, len, to, eof, &i, "trailer", 7); i++) {
+        if (i == 0 || ! PDXSweepIsRegular(buf[i-1])) 
+            PDXSweepAddTrailer(S, base + (PDOffset)i, false);
+    }
+    
+    // /XRef (but not /XRefStm) and /Catalog are attributed to the object they appear in
+    for (i = from; PDXSweepFind(buf, len, to, eof, &i, "/XRef", 5); i++) {
+        ob = PDXSweepEnclosingObject(S, base + (PDOffset)i);
+        if (ob >= 0 && (S->trailercount == 0 || S->trailers[S->trailercount-1].offset != S->obs[ob].offset))
+            PDXSweepAddTrailer(S, S->obs[ob].offset, true);
+    }
+    
+    for (i = from; PDXSweepFind(buf, len, to, eof, &i, "/ObjStm", 7); i++) {
+        ob = PDXSweepEnclosingObject(S, base + (PDOffset)i);
+        if (ob < 0 || (S->objstmcount > 0 && S->objstms[S->objstmcount-1] == ob)) continue;
+        if (S->objstmcount == S->objstmcap) {
+            S->objstmcap = S->objstmcap ? S->objstmcap * 2 : 32;
+            S->objstms = realloc(S->objstms, S->objstmcap * sizeof(PDInteger));
+        }
+        S->objstms[S->objstmcount++] = ob;
+    }
+    
+    for (i = from; PDXSweepFind(buf, len, to, eof, &i, "/Catalog", 8); i++) {
+        ob = PDXSweepEnclosingObject(S, base + (PDOffset)i);
+        if (ob >= 0) S->catalog = ob;
+    }
+}
+
+static int PDXSweepTrailerCompare(const void *a, const void *b)
+{
+    PDOffset x = ((const PDXSweepTrailer *)a)->offset;
+    PDOffset y = ((const PDXSweepTrailer *)b)->offset;
+    return x < y ? -1 : x > y;
+}
+
+static inline void PDXSweepReplaceRef(PDReferenceRef *ref, PDDictionaryRef dict, const char *key)
+{
+    void *value = PDDictionaryGet(dict, key);
+    if (value && PDResolve(value) == PDInstanceTypeRef) {
+        PDRelease(*ref);
+        *ref = PDRetain(value);
+    }
+}
+
+// read the header of the object stream defined at container->offset, and point the table entries of the objects it holds at it, unless an object was defined more recently elsewhere; returns the number of entries set
+static PDInteger PDXSweepReadObjectStream(PDTwinStreamRef stream, PDXTableRef pdx, PDXSweepObject *container)
+{
+    PDScannerRef scanner;
+    PDDictionaryRef dict = NULL;
+    PDStreamFilterRef filter;
+    void *filterName;
+    pd_stack stack = NULL;
+    char *raw = NULL;
+    char *buf = NULL;
+    char *kw;
+    PDInteger len, elen, n, first, i, b, obid;
+    PDInteger result = 0;
+
+    PDTwinStreamSeek(stream, (PDSize)container->offset);
+    scanner = PDTwinStreamCreateScanner(stream, pdfRoot);
+
+    if (! PDScannerPopStack(scanner, &stack) || ! PDIdentifies(stack->info, PD_OBJ)) goto done;
+    pd_stack_destroy(&stack);
+    if (! PDScannerPopStack(scanner, &stack) || ! PDIdentifies(stack->info, PD_DICT)) goto done;
+    pd_stack s = stack;
+    dict = PDInstanceCreateFromComplex(&s);
+
+    // stream lengths given as references would have to be resolved via the very table we're building, so those containers are left alone
+    void *length = PDDictionaryGet(dict, "Length");
+    if (length == NULL || PDResolve(length) != PDInstanceTypeNumber) goto done;
+    len = PDNumberGetInteger(length);
+    n = PDDictionaryGetInteger(dict, "N");
+    first = PDDictionaryGetInteger(dict, "First");
+    if (len <= 0 || n <= 0 || first <= 0) goto done;
+
+    if (! PDScannerPopString(scanner, &kw)) goto done;
+    b = strcmp(kw, "stream");
+    free(kw);
+    if (b) goto done;
+
+    raw = malloc(len + 1);
+    if (PDScannerReadStream(scanner, len, raw, len) < len) goto done;
+    elen = len;
+
+    filterName = PDDictionaryGet(dict, "Filter");
+    if (filterName) {
+        if (PDResolve(filterName) != PDInstanceTypeString) goto done;
+        filter = PDStreamFilterObtain(PDStringEscapedValue(filterName, false, NULL), true, PDDictionaryGet(dict, "DecodeParms"));
+        if (filter == NULL) goto done;
+        if (! PDStreamFilterApply(filter, (unsigned char *)raw, (unsigned char **)&buf, len, &elen, NULL)) {
+            free(buf);
+            PDRelease(filter);
+            goto done;
+        }
+        PDRelease(filter);
+        free(raw);
+        raw = buf;
+    }
+
+    // header: n pairs of "<obid> <offset>", ending at /First
+    if (first < elen) elen = first;
+    for (b = i = 0; i < n; i++) {
+        while (b < elen && ! PDXSweepIsDigit(raw[b])) b++;
+        for (obid = 0; b < elen && PDXSweepIsDigit(raw[b]); b++) obid = obid * 10 + raw[b] - '0';
+        while (b < elen && ! PDXSweepIsDigit(raw[b])) b++;
+        if (b == elen) break;
+        while (b < elen && PDXSweepIsDigit(raw[b])) b++;
+
+        if (obid == 0 || obid > PDX_SWEEP_MAXOBID) continue;
+        if (obid + 1 >= pdx->cap) {
+            // keep one entry in reserve for an XRef stream
+            PDXTableGrow(pdx, obid + 2);
+        }
+        if (obid >= pdx->count) pdx->count = obid + 1;
+
+        if (PDXTypeFreed == PDXTableGetTypeForID(pdx, obid) ||
+            (PDXTypeUsed == PDXTableGetTypeForID(pdx, obid) && PDXTableGetOffsetForID(pdx, obid) < container->offset)) {
+            PDXTableSetTypeForID(pdx, obid, PDXTypeComp);
+            PDXTableSetOffsetForID(pdx, obid, container->obid);
+            PDXTableSetGenForID(pdx, obid, i);
+            result++;
+        }
+    }
+
+done:
+    free(raw);
+    pd_stack_destroy(&stack);
+    PDRelease(dict);
+    PDRelease(scanner);
+    return result;
+}
+
+PDBool PDXTableRecoverXRefs(PDParserRef parser)
+{
+    struct PDXI X = PDXIStart(parser);
+    struct PDXSweep S = (struct PDXSweep) {NULL, 0, 0, NULL, 0, 0, NULL, 0, 0, -1, 0};
+    PDTwinStreamRef stream = X.stream;
+    PDSize size = PDTwinStreamGetInputSize(stream);
+    PDSize pos, behind, got, to;
+    PDInteger i, j, count;
+    PDBool binary;
+    
+    if (size == 0) return false;
+    
+    // drop whatever the failed attempt at reading the input's XRef data left behind
+    PDRelease(parser->mxt);
+    PDRelease(parser->cxt);
+    PDRelease(parser->trailer);
+    pd_stack_destroy(&parser->xstack);
+    parser->mxt = parser->cxt = NULL;
+    parser->trailer = NULL;
+    
+    PDTWinStreamSetMethod(stream, PDTwinStreamRandomAccess);
+    
+    // one linear pass over the input, locating object definitions, trailers, XRef streams and the catalog; every chunk is searched once per keyword, so chunks are kept small enough to stay in cache (mapped input is swept in place)
+    PDSize step = stream->mapped ? PDX_SWEEP_MAPPED : PDX_SWEEP_CHUNK;
+    char *chunk = stream->mapped ? NULL : malloc(PDX_SWEEP_BEHIND + PDX_SWEEP_CHUNK + PDX_SWEEP_AHEAD);
+    const char *buf;
+    for (pos = 0; pos < size; pos += step) {
+        behind = pos < PDX_SWEEP_BEHIND ? pos : PDX_SWEEP_BEHIND;
+        got = behind + step + PDX_SWEEP_AHEAD;
+        if (chunk) {
+            got = PDTwinStreamReadRange(stream, (PDOffset)(pos - behind), got, chunk);
+            buf = chunk;
+        } else {
+            if (got > size - (pos - behind)) got = size - (pos - behind);
+            buf = &stream->heap[pos - behind];
+        }
+        if (got <= behind) break;
+        to = behind + step < got ? behind + step : got;
+        PDXSweepChunk(&S, buf, got, (PDOffset)(pos - behind), behind, to, pos - behind + got >= size);
+    }
+    free(chunk);
+    
+    if (S.obcount == 0) {
+        PDWarn("no object definitions found in input; unable to reconstruct XRef table");
+        free(S.obs);
+        free(S.trailers);
+        free(S.objstms);
+        return false;
+    }
+    
+    qsort(S.trailers, S.trailercount, sizeof(PDXSweepTrailer), PDXSweepTrailerCompare);
+    
+    // trailers, in input order, so that the most recent one wins; XRef streams also hold the entries for objects inside of object streams, which a sweep can't see
+    PDXTableRef *streams = calloc(S.trailercount + 1, sizeof(PDXTableRef));
+    pd_stack tdef = NULL;
+    PDDictionaryRef tdict = NULL;
+    PDInteger tobid = -1;
+    count = S.maxobid + 1;
+    X.trailer = PDObjectCreate(0, 0);
+    
+    for (i = 0; i < S.trailercount; i++) {
+        PDTwinStreamSeek(stream, (PDSize)S.trailers[i].offset + (S.trailers[i].stream ? 0 : 7));
+        X.scanner = PDTwinStreamCreateScanner(stream, pdfRoot);
+        if (PDScannerPopStack(X.scanner, &X.stack)) {
+            if (S.trailers[i].stream && PDIdentifies(X.stack->info, PD_OBJ)) {
+                X.pdx = streams[i] = PDXTableCreate(NULL);
+                PDXTableReadXRefStreamContent(&X, S.trailers[i].offset);
+                if (streams[i]->count > count) count = streams[i]->count;
+                tobid = streams[i]->obid;
+            } else if (! S.trailers[i].stream && PDIdentifies(X.stack->info, PD_DICT)) {
+                PDRelease(X.dict);
+                pd_stack s = X.stack;
+                X.dict = PDInstanceCreateFromComplex(&s);
+                tobid = -1;
+            } else {
+                pd_stack_destroy(&X.stack);
+            }
+            
+            if (X.stack && X.dict) {
+                PDXSweepReplaceRef(&X.rootRef, X.dict, "Root");
+                PDXSweepReplaceRef(&X.infoRef, X.dict, "Info");
+                PDXSweepReplaceRef(&X.encryptRef, X.dict, "Encrypt");
+                pd_stack_destroy(&tdef);
+                PDRelease(tdict);
+                tdef = X.stack;
+                tdict = PDRetain(X.dict);
+                X.stack = NULL;
+            }
+        }
+        PDRelease(X.scanner);
+    }
+    X.scanner = NULL;
+    PDRelease(X.dict);
+    
+    // build the table; one extra entry is reserved in case an XRef stream has to be written
+    PDXTableRef pdx = PDXTableCreate(NULL);
+    PDXTableSetSizes(pdx, 1, 4, 2);
+    PDXTableSetDecoded(pdx, true);
+    PDXTableGrow(pdx, count + 1);
+    pdx->count = count;
+    PDXTableSetGenForID(pdx, 0, 65535);
+    
+    // later definitions of an object supersede earlier ones, as they would in an incremental update
+    for (i = 0; i < S.obcount; i++) {
+        PDXTableSetTypeForID(pdx, S.obs[i].obid, PDXTypeUsed);
+        PDXTableSetOffsetForID(pdx, S.obs[i].obid, S.obs[i].offset);
+        PDXTableSetGenForID(pdx, S.obs[i].obid, S.obs[i].genid);
+    }
+    
+    // compressed entries apply unless the object was (re)defined after the XRef stream
+    binary = false;
+    for (i = 0; i < S.trailercount; i++) {
+        PDXTableRef st = streams[i];
+        if (st == NULL) continue;
+        for (j = 1; j < st->count; j++) {
+            if (PDXTypeComp == PDXTableGetTypeForID(st, j) && 
+                (PDXTypeFreed == PDXTableGetTypeForID(pdx, j) || PDXTableGetOffsetForID(pdx, j) < S.trailers[i].offset)) {
+                PDXTableSetTypeForID(pdx, j, PDXTypeComp);
+                PDXTableSetOffsetForID(pdx, j, PDXTableGetOffsetForID(st, j));
+                PDXTableSetGenForID(pdx, j, PDXTableGetGenForID(st, j));
+                binary = true;
+            }
+        }
+    }
+
+    // object streams that no surviving XRef stream accounts for (e.g. because the input was cut short) are read directly, newest first; encrypted ones can't be read until the parser has its crypto set up, so they are left out
+    if (X.encryptRef == NULL) {
+        for (i = S.objstmcount - 1; i >= 0; i--) {
+            PDXSweepObject *container = &S.obs[S.objstms[i]];
+            if (PDXTypeUsed == PDXTableGetTypeForID(pdx, container->obid) && PDXTableGetOffsetForID(pdx, container->obid) == container->offset &&
+                PDXSweepReadObjectStream(stream, pdx, container) > 0)
+                binary = true;
+        }
+    }
+
+    // the old XRef streams are obsolete; dropping them from the table makes the parser skip past them
+    for (i = 0; i < S.trailercount; i++) {
+        if (streams[i] == NULL) continue;
+        j = streams[i]->obid;
+        if (j < pdx->count && PDXTypeUsed == PDXTableGetTypeForID(pdx, j) && PDXTableGetOffsetForID(pdx, j) == S.trailers[i].offset) {
+            PDXTableSetTypeForID(pdx, j, PDXTypeFreed);
+            PDXTableSetOffsetForID(pdx, j, 0);
+            PDXTableSetGenForID(pdx, j, 0);
+        }
+        PDRelease(streams[i]);
+    }
+    free(streams);
+    
+    // compressed entries can only be expressed in an XRef stream, which needs an object of its own
+    X.trailer->def = tdef;
+    X.trailer->inst = tdict;
+    PDDictionaryRef tobd = PDObjectGetDictionary(X.trailer);
+    if (binary) {
+        pdx->format = PDXTableFormatBinary;
+        pdx->obid = X.trailer->obid = pdx->count++;
+        PDXTableSetTypeForID(pdx, pdx->obid, PDXTypeUsed);
+        PDXTableSetOffsetForID(pdx, pdx->obid, (PDOffset)size);
+        PDXTableSetGenForID(pdx, pdx->obid, 0);
+        if (tobid < 0) PDDictionarySet(tobd, "Type", PDStringWithName(strdup("/XRef")));
+    } else {
+        pdx->format = PDXTableFormatText;
+        if (tobid >= 0) {
+            // the most recent trailer was an XRef stream, but none of its compressed entries survived, so we write a regular trailer with the essentials only
+            X.trailer->def = NULL;
+            X.trailer->inst = NULL;
+            tobd = PDObjectGetDictionary(X.trailer);
+            if (PDDictionaryGet(tdict, "ID")) PDDictionarySet(tobd, "ID", PDDictionaryGet(tdict, "ID"));
+            if (X.infoRef) PDDictionarySet(tobd, "Info", X.infoRef);
+            if (X.encryptRef) PDDictionarySet(tobd, "Encrypt", X.encryptRef);
+            pd_stack_destroy(&tdef);
+            PDRelease(tdict);
+        }
+    }
+    
+    if (X.rootRef == NULL && S.catalog >= 0) {
+        PDNotice("no trailer with a /Root found; using object #%ld, which looks like the catalog", S.obs[S.catalog].obid);
+        X.rootRef = PDReferenceCreate(S.obs[S.catalog].obid, S.obs[S.catalog].genid);
+    }
+    if (X.rootRef) PDDictionarySet(tobd, "Root", X.rootRef);
+    
+    // the reconstructed table applies to the entire input, and any XRef sections encountered along the way are ignored
+    pdx->linearized = true;
+    pdx->pos = size;
+    
+    parser->trailer = X.trailer;
+    parser->mxt = PDXTableCreate(pdx);
+    parser->cxt = pdx;
+    parser->xstack = NULL;
+    parser->startxref = 0;
+    parser->xrefnewiter = 1;
+    parser->rootRef = X.rootRef;
+    parser->infoRef = X.infoRef;
+    parser->encryptRef = X.encryptRef;
+    
+    PDOffset *boundaries = malloc((S.trailercount + 1) * sizeof(PDOffset));
+    for (i = 0; i < S.trailercount; i++) boundaries[i] = S.trailers[i].offset;
+    boundaries[i] = (PDOffset)size;
+    PDXTableBuildOffsetIndex(parser->mxt, boundaries, S.trailercount + 1);
+    free(boundaries);
+    
+    PDNotice("reconstructed XRef table with %ld objects from %ld definitions and %ld trailers", pdx->count, S.obcount, S.trailercount);
+    
+    free(S.obs);
+    free(S.trailers);
+    free(S.objstms);
+    
+    PDTWinStreamSetMethod(stream, PDTwinStreamReadWrite);
+    
+    return true;
+}
+
 PDArrayRef PDXTableWEntry(PDXTableRef table)
 {
     if (table->w) return table->w;
@@ -1177,7 +1931,7 @@ void PDXTableSetSizes(PDXTableRef table, unsigned char typeSize, unsigned char o
         PDXTableRef tmp = PDXTableCreate(NULL);
         PDXTableSetSizes(tmp, typeSize, offsSize, genSize);
         char *newXrefs = xrefalloc(table, table->cap, newWidth); //malloc(table->cap * newWidth);
-        for (int i = 0; i < table->count; i++) {
+        for (int i = 0; i < table->cap; i++) {
             _PDXSetTypeForID(newXrefs, tmp, i, PDXTableGetTypeForID(table, i));
             _PDXSetOffsetForID(newXrefs, tmp, i, PDXTableGetOffsetForID(table, i));
             _PDXSetGenForID(newXrefs, tmp, i, PDXTableGetGenForID(table, i));
@@ -1203,73 +1957,534 @@ void PDXTableSetSizes(PDXTableRef table, unsigned char typeSize, unsigned char o
     table->width = newWidth;
 }
 
+void PDXTableSetMinimalSizes(PDXTableRef table)
+{
+    PDOffset maxOffs = 0;
+    PDInteger maxGen = 0;
+    unsigned char offsSize = 1;
+    unsigned char genSize = 1;
+    
+    for (PDInteger i = 0; i < table->count; i++) {
+        PDOffset offs = PDXTableGetOffsetForID(table, i);
+        PDInteger gen = PDXTableGetGenForID(table, i);
+        if (offs > maxOffs) maxOffs = offs;
+        if (gen > maxGen) maxGen = gen;
+    }
+    
+    while (offsSize < sizeof(PDOffset) && maxOffs >> (offsSize << 3)) offsSize++;
+    while (genSize < sizeof(PDInteger) && maxGen >> (genSize << 3)) genSize++;
+    
+    if (offsSize != table->offsSize || genSize != table->genSize) 
+        PDXTableSetSizes(table, table->typeSize, offsSize, genSize);
+}
+
 void PDXTableGrow(PDXTableRef table, PDSize cap)
 {
+    PDSize prevCap = table->cap;
     table->cap = cap;
     table->xrefs = xrefrealloc(table, table->xrefs, cap, table->width);
+    if (table->decOffs) {
+        table->decOffs = realloc(table->decOffs, (cap + 1) * sizeof(PDOffset));
+        table->decGens = realloc(table->decGens, (cap + 1) * sizeof(PDInteger));
+        table->decTypes = realloc(table->decTypes, cap + 1);
+    }
+    
+    if (cap > prevCap) {
+        memset(&table->xrefs[prevCap * table->width], 0, (cap - prevCap) * table->width);
+        if (table->decOffs) {
+            memset(&table->decOffs[prevCap], 0, (cap - prevCap) * sizeof(PDOffset));
+            memset(&table->decGens[prevCap], 0, (cap - prevCap) * sizeof(PDInteger));
+            memset(&table->decTypes[prevCap], 0, cap - prevCap);
+        }
+    }
 }
 
-//#define DEBUG_PDX_GNAI
-
-struct gnai_s {
-    PDInteger *nextOb;
-    PDInteger  prevOb;
-#ifdef DEBUG_PDX_GNAI
-    PDInteger  prevOffset;
-    PDSize     cap;
-#endif
-};
+void PDXTableSetDecoded(PDXTableRef table, PDBool decoded)
+{
+    if (decoded == (table->decOffs != NULL)) return;
+    
+    if (! decoded) {
+        free(table->decOffs);
+        free(table->decGens);
+        free(table->decTypes);
+        table->decOffs = NULL;
+        table->decGens = NULL;
+        table->decTypes = NULL;
+        return;
+    }
+    
+    PDSize cap = table->cap;
+    PDOffset *offs = malloc((cap + 1) * sizeof(PDOffset));
+    PDInteger *gens = malloc((cap + 1) * sizeof(PDInteger));
+    PDXType *types = malloc(cap + 1);
+    
+    if (table->xrefs) {
+        for (PDSize i = 0; i < cap; i++) {
+            types[i] = (PDXType)table->xrefs[i * table->width];
+            offs[i] = PDXTableGetPackedOffsetForID(table, i);
+            gens[i] = PDXTableGetPackedGenForID(table, i);
+        }
+    }
+    
+    table->decOffs = offs;
+    table->decGens = gens;
+    table->decTypes = types;
+}
 
-void PDXTableGNAIterator(PDInteger key, void *value, void *userInfo, PDBool *shouldStop)
+static int PDXTableOffsetCompare(const void *a, const void *b)
 {
-    struct gnai_s *gna = userInfo;
-    PDInteger obid = (PDInteger)value;
-#ifdef DEBUG_PDX_GNAI
-    PDInteger offs = key;
-    PDAssert(gna->cap > obid);
-    PDAssert(gna->prevOffset < offs);
-    gna->prevOffset = offs;
-#endif
-    if (gna->prevOb) gna->nextOb[gna->prevOb] = obid;
-    gna->prevOb = obid;
+    PDOffset x = *(const PDOffset *)a;
+    PDOffset y = *(const PDOffset *)b;
+    return x < y ? -1 : x > y;
 }
 
-void PDXTableGenerateNextArray(PDXTableRef table)
+void PDXTableBuildOffsetIndex(PDXTableRef table, PDOffset *boundaries, PDSize count)
 {
-    struct gnai_s userInfo;
     PDSize cap = table->count;
-    PDSplayTreeRef tree = PDSplayTreeCreate();
-    for (PDSize i = 1; i < cap; i++) {
+    PDSize n = 0;
+    PDSize i, j;
+    
+    if (table->offsets) free(table->offsets);
+    PDOffset *offsets = table->offsets = malloc((cap + count + 1) * sizeof(PDOffset));
+    
+    for (i = 1; i < cap; i++) {
         if (PDXTableGetTypeForID(table, i) == PDXTypeUsed) {
-            PDOffset offs = PDXTableGetOffsetForID(table, i);
-            PDSplayTreeInsert(tree, (PDInteger)offs, (void *)i);
+            offsets[n++] = PDXTableGetOffsetForID(table, i);
         }
     }
+    for (i = 0; i < count; i++) {
+        offsets[n++] = boundaries[i];
+    }
     
-    PDInteger *nextOb = table->nextOb = calloc(cap, sizeof(PDInteger));
-    userInfo.nextOb = nextOb;
-    userInfo.prevOb = 0;
-#ifdef DEBUG_PDX_GNAI
-    userInfo.prevOffset = -1;
-    userInfo.cap = cap;
-#endif
-    PDSplayTreeIterate(tree, PDXTableGNAIterator, &userInfo);
-    PDRelease(tree);
+    qsort(offsets, n, sizeof(PDOffset), PDXTableOffsetCompare);
+    
+    // drop duplicates (e.g. XRef streams, which are both objects and XRef sections)
+    for (i = j = 0; i < n; i++) {
+        if (j == 0 || offsets[j-1] != offsets[i]) offsets[j++] = offsets[i];
+    }
+    table->offsetCount = j;
+}
+
+PDSize PDXTableDetermineSizeAtOffset(PDXTableRef table, PDOffset offset)
+{
+    PDOffset *offsets = table->offsets;
+    PDSize lo = 0;
+    PDSize hi = table->offsetCount;
+    PDSize mid;
+    
+    // find the first entry beyond offset
+    while (lo < hi) {
+        mid = (lo + hi) >> 1;
+        if (offsets[mid] <= offset) lo = mid + 1; else hi = mid;
+    }
+    
+    return lo < table->offsetCount ? (PDSize)(offsets[lo] - offset) : 0;
 }
 
 PDSize PDXTableDetermineObjectSize(PDXTableRef table, PDInteger obid)
 {
-    if (table->nextOb == NULL) {
-        PDXTableGenerateNextArray(table);
+    if (table->offsets == NULL) {
+        PDXTableBuildOffsetIndex(table, NULL, 0);
+    }
+    return PDXTableDetermineSizeAtOffset(table, PDXTableGetOffsetForID(table, obid));
+}
+
+//
+// Index sidecar
+//
+
+#define PDX_SIDECAR_MAGIC   "PDXINDEX"
+#define PDX_SIDECAR_VERSION 1
+#define PDX_SIDECAR_SAMPLE  65536   // bytes at the start and at the end of the input which are hashed into the sidecar key
+#define PDX_SIDECAR_SIZES   (int32_t)(sizeof(PDInteger) | sizeof(PDOffset) << 8 | sizeof(PDSize) << 16)
+
+/**
+ Sidecar key, identifying the input a sidecar was written for.
+ */
+typedef struct PDXSidecarKey PDXSidecarKey;
+struct PDXSidecarKey {
+    int64_t  size;                  ///< input size in bytes
+    int64_t  mtime;                 ///< input modification time, in seconds
+    uint64_t hash;                  ///< FNV-1a hash of the first and last PDX_SIDECAR_SAMPLE bytes of the input
+};
+
+/**
+ Sidecar header. Everything in a sidecar is stored in host byte order and with host type sizes, as sidecars are caches which are only ever read back on the machine that wrote them; a mismatch simply means the sidecar is rewritten.
+ */
+typedef struct PDXSidecarHeader PDXSidecarHeader;
+struct PDXSidecarHeader {
+    char          magic[8];         ///< PDX_SIDECAR_MAGIC
+    int32_t       version;          ///< PDX_SIDECAR_VERSION
+    int32_t       sizes;            ///< PDX_SIDECAR_SIZES
+    PDXSidecarKey key;              ///< key of the input
+    int64_t       startxref;        ///< the input's startxref offset
+    int64_t       refs[6];          ///< object and generation numbers of the root, info and encrypt references; the object number is 0 for missing references
+    int64_t       trailerObid;      ///< object number of the trailer (0 unless the master XRef is a stream)
+    int64_t       trailer;          ///< file offset of the trailer dictionary, in PDF syntax
+    int64_t       trailerLen;       ///< length of the trailer dictionary
+    int64_t       tableCount;       ///< number of tables; the master table comes first, followed by the current table and the rest of the XRef stack, top to bottom
+    int64_t       tables;           ///< file offset of the table records
+    int64_t       offsetCount;      ///< number of entries in the master table's offset index
+    int64_t       offsets;          ///< file offset of the master table's offset index
+    int64_t       pageCount;        ///< number of pages
+    int64_t       pages;            ///< file offset of the object numbers of the pages, or 0 if the page list has not been stored (yet)
+};
+
+/**
+ Sidecar table record.
+ */
+typedef struct PDXSidecarTable PDXSidecarTable;
+struct PDXSidecarTable {
+    int64_t obid;                   ///< the table's obid
+    int64_t pos;                    ///< the table's pos
+    int64_t cap;                    ///< the table's cap
+    int64_t count;                  ///< the table's count
+    int64_t data;                   ///< file offset of the packed entries (cap * width bytes), followed by the decoded offsets, generation numbers and types (cap entries each, 8 byte aligned)
+    int32_t format;                 ///< the table's format
+    int32_t linearized;             ///< the table's linearized flag
+    unsigned char typeSize;         ///< type size
+    unsigned char offsSize;         ///< offset size
+    unsigned char genSize;          ///< generation number size
+    unsigned char pad[5];
+};
+
+/**
+ Sidecar state of a parser.
+ */
+struct PDXSidecar {
+    char         *path;             ///< sidecar path
+    PDXSidecarKey key;              ///< key of the parser's input
+    PDInteger    *kids;             ///< object numbers of the pages, as read from the sidecar, until handed over to the catalog
+    PDInteger     kidCount;         ///< number of entries in kids
+    PDBool        hasPages;         ///< whether the sidecar holds a page list (or a page list was written to it)
+};
+
+#define PDXSidecarAlign(n)      (((n) + 7) & ~(int64_t)7)
+#define PDXSidecarFits(o, l)    ((o) >= 0 && (l) >= 0 && (o) <= size && (l) <= size - (o))
+
+static PDBool PDXSidecarKeyForStream(PDTwinStreamRef stream, PDXSidecarKey *key)
+{
+    struct stat st;
+    
+    // the key is tied to a file, so buffers and spooled (non-regular) input can't be indexed
+    if (stream->fi == NULL || stream->spooled || stream->spill || fstat(fileno(stream->fi), &st) || ! S_ISREG(st.st_mode)) 
+        return false;
+    
+    memset(key, 0, sizeof(PDXSidecarKey));
+    key->size = st.st_size;
+    key->mtime = st.st_mtime;
+    
+    char *buf = malloc(PDX_SIDECAR_SAMPLE);
+    uint64_t hash = 14695981039346656037ULL;
+    PDOffset at = 0;
+    PDSize len, i;
+    do {
+        len = PDTwinStreamReadRange(stream, at, PDX_SIDECAR_SAMPLE, buf);
+        for (i = 0; i < len; i++) {
+            hash = (hash ^ (unsigned char)buf[i]) * 1099511628211ULL;
+        }
+        at = at == 0 && key->size > PDX_SIDECAR_SAMPLE ? key->size - PDX_SIDECAR_SAMPLE : -1;
+    } while (at > 0);
+    free(buf);
+    
+    key->hash = hash;
+    return true;
+}
+
+static PDBool PDXSidecarRead(PDParserRef parser, const char *map, int64_t size)
+{
+    struct PDXSidecar *sidecar = parser->sidecar;
+    const PDXSidecarHeader *h = (const PDXSidecarHeader *)map;
+    const PDXSidecarTable *r;
+    PDXTableRef *tables;
+    PDXTableRef t;
+    int64_t i, width, span;
+    
+    if (memcmp(h->magic, PDX_SIDECAR_MAGIC, 8) || h->version != PDX_SIDECAR_VERSION || h->sizes != PDX_SIDECAR_SIZES || memcmp(&h->key, &sidecar->key, sizeof(PDXSidecarKey))) 
+        return false;
+    
+    if (h->tableCount < 2 || h->tableCount > size || h->offsetCount > size || h->pageCount > size || 
+        ! PDXSidecarFits(h->tables, h->tableCount * (int64_t)sizeof(PDXSidecarTable)) ||
+        ! PDXSidecarFits(h->trailer, h->trailerLen) ||
+        ! PDXSidecarFits(h->offsets, h->offsetCount * (int64_t)sizeof(PDOffset)) ||
+        (h->pages && ! PDXSidecarFits(h->pages, h->pageCount * (int64_t)sizeof(PDInteger)))) 
+        return false;
+    
+    // tables
+    tables = calloc(h->tableCount, sizeof(PDXTableRef));
+    r = (const PDXSidecarTable *)&map[h->tables];
+    for (i = 0; i < h->tableCount; i++, r++) {
+        width = r->typeSize + r->offsSize + r->genSize;
+        span = PDXSidecarAlign(r->cap * width) + r->cap * (int64_t)(sizeof(PDOffset) + sizeof(PDInteger)) + r->cap;
+        if (r->typeSize != 1 || r->offsSize < 1 || r->offsSize > 8 || r->genSize < 1 || r->genSize > sizeof(PDInteger) || 
+            r->cap < 1 || r->cap > size || r->count < 0 || r->count > r->cap || ! PDXSidecarFits(r->data, span)) 
+            break;
+        
+        tables[i] = t = PDXTableCreate(NULL);
+        PDXTableSetSizes(t, r->typeSize, r->offsSize, r->genSize);
+        PDXTableSetDecoded(t, true);
+        PDXTableGrow(t, (PDSize)r->cap);
+        t->obid = (PDInteger)r->obid;
+        t->pos = (PDSize)r->pos;
+        t->count = (PDSize)r->count;
+        t->format = (PDXFormat)r->format;
+        t->linearized = r->linearized != 0;
+        
+        const char *data = &map[r->data];
+        memcpy(t->xrefs, data, r->cap * width);
+        data += PDXSidecarAlign(r->cap * width);
+        memcpy(t->decOffs, data, r->cap * sizeof(PDOffset));
+        data += r->cap * sizeof(PDOffset);
+        memcpy(t->decGens, data, r->cap * sizeof(PDInteger));
+        data += r->cap * sizeof(PDInteger);
+        memcpy(t->decTypes, data, r->cap);
+    }
+    
+    // trailer; the scanner needs a writable buffer, so the dictionary is copied out of the mapping
+    pd_stack tdef = NULL;
+    PDDictionaryRef tdict = NULL;
+    if (i == h->tableCount) {
+        char *tbuf = malloc(h->trailerLen + 1);
+        memcpy(tbuf, &map[h->trailer], h->trailerLen);
+        tbuf[h->trailerLen] = 0;
+        tdef = PDScannerGenerateStackFromFixedBuffer(pdfRoot, tbuf, h->trailerLen);
+        free(tbuf);
+        tdict = PDInstanceCreateFromComplex(&tdef);
+        if (tdict && PDInstanceTypeDict != PDResolve(tdict)) {
+            PDRelease(tdict);
+            tdict = NULL;
+        }
     }
-    PDInteger nextOb = table->nextOb[obid];
-    if (! nextOb) {
-        // we give back a rather high value, but we don't want to risk not being able to read in an object; and chances are this is the very last object in the file so reading until the end of the buffer will not be super time consuming (we will get some overhead in terms of mem use for a sec though)
-        return 2500000;
+    
+    if (tdict == NULL) {
+        for (i = 0; i < h->tableCount; i++) PDRelease(tables[i]);
+        free(tables);
+        pd_stack_destroy(&tdef);
+        return false;
+    }
+    
+    // everything checks out, so we set the parser up the way PDXTableFetchXRefs would have
+    parser->trailer = PDObjectCreate((PDInteger)h->trailerObid, 0);
+    parser->trailer->def = tdef;
+    parser->trailer->inst = tdict;
+    
+    parser->mxt = tables[0];
+    parser->cxt = tables[1];
+    parser->xstack = NULL;
+    for (i = h->tableCount - 1; i > 1; i--) {
+        pd_stack_push_object(&parser->xstack, tables[i]);
+    }
+    free(tables);
+    
+    parser->mxt->offsetCount = (PDSize)h->offsetCount;
+    parser->mxt->offsets = malloc((h->offsetCount + 1) * sizeof(PDOffset));
+    memcpy(parser->mxt->offsets, &map[h->offsets], h->offsetCount * sizeof(PDOffset));
+    
+    parser->startxref = (PDSize)h->startxref;
+    parser->xrefnewiter = 1;
+    if (h->refs[0]) parser->rootRef = PDReferenceCreate((PDInteger)h->refs[0], (PDInteger)h->refs[1]);
+    if (h->refs[2]) parser->infoRef = PDReferenceCreate((PDInteger)h->refs[2], (PDInteger)h->refs[3]);
+    if (h->refs[4]) parser->encryptRef = PDReferenceCreate((PDInteger)h->refs[4], (PDInteger)h->refs[5]);
+    
+    if (h->pages) {
+        sidecar->kids = malloc((h->pageCount + 1) * sizeof(PDInteger));
+        memcpy(sidecar->kids, &map[h->pages], h->pageCount * sizeof(PDInteger));
+        sidecar->kidCount = (PDInteger)h->pageCount;
+        sidecar->hasPages = true;
+    }
+    
+    // the stream never left read/write mode, but it goes through the same transition as it would have after reading the XRefs, so that it starts over from the top (and starts reading ahead, if it does that)
+    PDTWinStreamSetMethod(parser->stream, PDTwinStreamRandomAccess);
+    PDTWinStreamSetMethod(parser->stream, PDTwinStreamReadWrite);
+    
+    return true;
+}
+
+PDBool PDXTableFetchSidecar(PDParserRef parser, const char *path)
+{
+    PDXSidecarKey key;
+    struct stat st;
+    char *map;
+    
+    if (! PDXSidecarKeyForStream(parser->stream, &key)) {
+        PDNotice("input is not a regular file; not using index sidecar %s", path);
+        return false;
     }
     
-    PDOffset startOffset = PDXTableGetOffsetForID(table, obid);
-    PDOffset endOffset = PDXTableGetOffsetForID(table, nextOb);
-    PDAssert(endOffset > startOffset); // crash = the XRef table is broken; the object (obid) is said to be at the same position or after the object that is supposedly after it (nextOb)
-    return (PDSize) (endOffset - startOffset);
+    struct PDXSidecar *sidecar = parser->sidecar = calloc(1, sizeof(struct PDXSidecar));
+    sidecar->path = strdup(path);
+    sidecar->key = key;
+    
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+    
+    map = NULL;
+    if (0 == fstat(fd, &st) && st.st_size >= (off_t)sizeof(PDXSidecarHeader)) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) map = NULL;
+    }
+    close(fd);
+    
+    PDBool success = map && PDXSidecarRead(parser, map, st.st_size);
+    if (map) munmap(map, st.st_size);
+    
+    if (! success) {
+        PDNotice("index sidecar %s is stale or invalid; rebuilding it", path);
+    }
+    return success;
+}
+
+static PDBool PDXSidecarPut(FILE *f, int64_t *pos, const void *data, int64_t len)
+{
+    static const char zeros[8] = {0};
+    int64_t pad = PDXSidecarAlign(len) - len;
+    if (len > 0 && 1 != fwrite(data, len, 1, f)) return false;
+    if (pad > 0 && 1 != fwrite(zeros, pad, 1, f)) return false;
+    *pos += len + pad;
+    return true;
+}
+
+void PDXTableStoreSidecar(PDParserRef parser)
+{
+    struct PDXSidecar *sidecar = parser->sidecar;
+    if (sidecar == NULL) return;
+    
+    PDXSidecarHeader h;
+    PDXSidecarTable *records;
+    PDXTableRef t;
+    pd_stack iter;
+    int64_t pos, i, n;
+    PDBool success;
+    
+    memset(&h, 0, sizeof(PDXSidecarHeader));
+    memcpy(h.magic, PDX_SIDECAR_MAGIC, 8);
+    h.version = PDX_SIDECAR_VERSION;
+    h.sizes = PDX_SIDECAR_SIZES;
+    h.key = sidecar->key;
+    h.startxref = parser->startxref;
+    if (parser->rootRef) { h.refs[0] = parser->rootRef->obid; h.refs[1] = parser->rootRef->genid; }
+    if (parser->infoRef) { h.refs[2] = parser->infoRef->obid; h.refs[3] = parser->infoRef->genid; }
+    if (parser->encryptRef) { h.refs[4] = parser->encryptRef->obid; h.refs[5] = parser->encryptRef->genid; }
+    h.trailerObid = parser->trailer->obid;
+    
+    n = 2;
+    pd_stack_for_each(parser->xstack, iter) n++;
+    PDXTableRef *tables = malloc(n * sizeof(PDXTableRef));
+    tables[0] = parser->mxt;
+    tables[1] = parser->cxt;
+    i = 2;
+    pd_stack_for_each(parser->xstack, iter) tables[i++] = iter->info;
+    records = calloc(n, sizeof(PDXSidecarTable));
+    
+    // the sidecar is written to a temporary file, which replaces the old one once complete, so that readers never see a partial sidecar
+    PDInteger plen = strlen(sidecar->path);
+    char *tmp = malloc(plen + 5);
+    sprintf(tmp, "%s.tmp", sidecar->path);
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        PDNotice("unable to write index sidecar %s", sidecar->path);
+        free(tmp);
+        free(tables);
+        free(records);
+        return;
+    }
+    
+    pos = 0;
+    success = PDXSidecarPut(f, &pos, &h, sizeof(PDXSidecarHeader));
+    
+    PDInteger tlen = 0;
+    char *tstr = PDDictionaryToString(PDObjectGetDictionary(parser->trailer), &tlen);
+    h.trailer = pos;
+    h.trailerLen = tlen;
+    success &= PDXSidecarPut(f, &pos, tstr, tlen);
+    free(tstr);
+    
+    h.offsets = pos;
+    h.offsetCount = parser->mxt->offsets ? parser->mxt->offsetCount : 0;
+    success &= PDXSidecarPut(f, &pos, parser->mxt->offsets, h.offsetCount * sizeof(PDOffset));
+    
+    for (i = 0; success && i < n; i++) {
+        t = tables[i];
+        PDXTableSetDecoded(t, true);
+        records[i].obid = t->obid;
+        records[i].pos = t->pos;
+        records[i].cap = t->cap;
+        records[i].count = t->count;
+        records[i].format = t->format;
+        records[i].linearized = t->linearized;
+        records[i].typeSize = t->typeSize;
+        records[i].offsSize = t->offsSize;
+        records[i].genSize = t->genSize;
+        records[i].data = pos;
+        success = (PDXSidecarPut(f, &pos, t->xrefs, t->cap * t->width) &&
+                   PDXSidecarPut(f, &pos, t->decOffs, t->cap * sizeof(PDOffset)) &&
+                   PDXSidecarPut(f, &pos, t->decGens, t->cap * sizeof(PDInteger)) &&
+                   PDXSidecarPut(f, &pos, t->decTypes, t->cap));
+    }
+    
+    h.tables = pos;
+    h.tableCount = n;
+    success = (success && 
+               PDXSidecarPut(f, &pos, records, n * sizeof(PDXSidecarTable)) && 
+               0 == fseek(f, 0, SEEK_SET) && 
+               1 == fwrite(&h, sizeof(PDXSidecarHeader), 1, f));
+    success &= 0 == fclose(f);
+    
+    if (! success || rename(tmp, sidecar->path)) {
+        PDNotice("unable to write index sidecar %s", sidecar->path);
+        unlink(tmp);
+    }
+    
+    free(tmp);
+    free(tables);
+    free(records);
+}
+
+PDInteger *PDXTableTakeSidecarPages(PDParserRef parser, PDInteger *count)
+{
+    struct PDXSidecar *sidecar = parser->sidecar;
+    if (sidecar == NULL || sidecar->kids == NULL) return NULL;
+    
+    PDInteger *kids = sidecar->kids;
+    *count = sidecar->kidCount;
+    sidecar->kids = NULL;
+    return kids;
+}
+
+void PDXTableStoreSidecarPages(PDParserRef parser, PDInteger *kids, PDInteger count)
+{
+    struct PDXSidecar *sidecar = parser->sidecar;
+    if (sidecar == NULL || sidecar->hasPages) return;
+    sidecar->hasPages = true;
+    
+    PDXSidecarHeader h;
+    int64_t start, pos;
+    FILE *f = fopen(sidecar->path, "r+b");
+    if (f == NULL) return;
+    
+    // the page list is appended to the sidecar, provided it is still the one for this input, and the header is updated last
+    if (1 == fread(&h, sizeof(PDXSidecarHeader), 1, f) && 
+        0 == memcmp(h.magic, PDX_SIDECAR_MAGIC, 8) && h.version == PDX_SIDECAR_VERSION && h.sizes == PDX_SIDECAR_SIZES && 
+        0 == memcmp(&h.key, &sidecar->key, sizeof(PDXSidecarKey)) && 0 == h.pages && 
+        0 == fseek(f, 0, SEEK_END) && (start = pos = ftell(f)) > 0) {
+        h.pages = start;
+        h.pageCount = count;
+        if (! PDXSidecarPut(f, &pos, kids, count * sizeof(PDInteger)) || 0 != fflush(f) || 
+            0 != fseek(f, 0, SEEK_SET) || 1 != fwrite(&h, sizeof(PDXSidecarHeader), 1, f)) {
+            PDNotice("unable to store page list in index sidecar %s", sidecar->path);
+        }
+    }
+    
+    fclose(f);
+}
+
+void PDXTableDestroySidecar(PDParserRef parser)
+{
+    struct PDXSidecar *sidecar = parser->sidecar;
+    if (sidecar == NULL) return;
+    
+    free(sidecar->path);
+    free(sidecar->kids);
+    free(sidecar);
+    parser->sidecar = NULL;
 }
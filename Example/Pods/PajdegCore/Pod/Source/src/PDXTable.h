@@ -107,7 +107,12 @@ struct PDXTable {
     PDOffset    offsCap;    ///< threshold for offsets using current offsSize
     
     PDArrayRef  w;          ///< The W entry, if set.
-    PDInteger  *nextOb;     ///< Array of object id's succeeding the object for the given array index. I.e. if the file has 4 0 obj ... endobj 10 0 obj ... endobj, then next[4] == 10 because object 10 is directly below object 4. This array is NULL until the first call to PDXTableDetermineObjectSize is made.
+    PDOffset   *offsets;    ///< Sorted, unique input offsets of every used object in the table, as well as of every XRef section and the end of the input, if known. The size of an object is the distance to the first entry beyond its offset. This array is NULL until PDXTableBuildOffsetIndex or PDXTableDetermineObjectSize is called.
+    PDSize      offsetCount;///< Number of entries in offsets.
+    
+    PDOffset   *decOffs;    ///< Decoded offsets (or containing object stream IDs), indexed by object ID, or NULL if the table is not decoded. See PDXTableSetDecoded.
+    PDInteger  *decGens;    ///< Decoded generation numbers (or object stream indices), or NULL if the table is not decoded.
+    PDXType    *decTypes;   ///< Decoded types, or NULL if the table is not decoded.
     
     unsigned char typeSize;   ///< type size, current implementation requires this to be 1
     unsigned char offsSize;   ///< offset size
@@ -141,7 +146,7 @@ extern void PDXTableSetOffsetForID(PDXTableRef table, PDInteger obid, PDOffset o
  @param xrefs The XREF buffer
  @param id The object ID.
  */
-#define PDXTableGetTypeForID(table, id)         (PDXType)((table->xrefs)[id*table->width])
+#define PDXTableGetTypeForID(table, id)         ((table)->decTypes ? (table)->decTypes[id] : (PDXType)(((table)->xrefs)[(id)*(table)->width]))
 //extern PDInteger PDXTableGetTypeForID(PDXTableRef table, PDInteger obid);
 
 /**
@@ -151,7 +156,7 @@ extern void PDXTableSetOffsetForID(PDXTableRef table, PDInteger obid, PDOffset o
  @param id The object ID.
  @param t The new type.
  */
-#define PDXTableSetTypeForID(table, id, t)    *(PDXType*)&((table->xrefs)[id*table->width]) = t
+#define PDXTableSetTypeForID(table, id, t)    do { if ((table)->decTypes) (table)->decTypes[id] = (t); *(PDXType*)&(((table)->xrefs)[(id)*(table)->width]) = (t); } while (0)
 //extern void PDXTableSetTypeForID(PDXTableRef table, PDInteger obid, PDInteger type);
 
 /**
@@ -243,6 +248,67 @@ extern void PDXTableSetGenForID(PDXTableRef table, PDInteger obid, PDInteger gen
  */
 extern PDBool PDXTableFetchXRefs(PDParserRef parser);
 
+/**
+ Reconstruct the XREF data of a PDF whose XREF tables or streams could not be read.
+ 
+ The input is swept once, front to back, for "N G obj" definitions, "trailer" dictionaries, and XRef streams (objects with a /XRef name), and a single table covering the entire input is built from the results, where later definitions of an object supersede earlier ones. Entries for objects inside of object streams are taken from any XRef streams that can be read, and otherwise from the headers of the object streams themselves (unless the PDF is encrypted). The trailer is taken from the most recent trailer dictionary or XRef stream; if none has a /Root entry, the last object with a /Catalog name in it is used.
+ 
+ The parser is set up as if PDXTableFetchXRefs had succeeded. Any XREF sections encountered while iterating over the input are skipped.
+ 
+ @param parser The parser.
+ @return true if at least one object definition was found, false otherwise.
+ */
+extern PDBool PDXTableRecoverXRefs(PDParserRef parser);
+
+/**
+ Attach an index sidecar to the parser, and set up the parser's XREF data from it, if it is valid for the input.
+ 
+ A sidecar holds a snapshot of everything PDXTableFetchXRefs derives from the input -- the XREF tables (packed and decoded), the master table's offset index, the trailer, and the root, info and encrypt references -- and optionally the object IDs of the document's pages (see PDXTableStoreSidecarPages). It is keyed on the input's size, modification time, and a hash of its first and last 64 kB, and is memory mapped and validated as a whole before anything is taken from it.
+ 
+ The sidecar is attached even if it does not exist or does not match the input, so that a subsequent call to PDXTableStoreSidecar can (re)write it. Nothing is attached for input which is not a regular file.
+ 
+ @param parser The parser.
+ @param path Path of the sidecar.
+ @return true if the parser was set up from the sidecar, as if PDXTableFetchXRefs had succeeded; false if the XREF data has to be read from the input.
+ */
+extern PDBool PDXTableFetchSidecar(PDParserRef parser, const char *path);
+
+/**
+ Write the parser's XREF data to its index sidecar, replacing any existing sidecar. Does nothing if no sidecar is attached.
+ 
+ Must be called before the parser makes any changes to its XREF tables, i.e. right after PDXTableFetchXRefs.
+ 
+ @param parser The parser.
+ */
+extern void PDXTableStoreSidecar(PDParserRef parser);
+
+/**
+ Take the object IDs of the document's pages read from the parser's index sidecar, if it held any.
+ 
+ The caller takes ownership of the returned array, and subsequent calls return NULL.
+ 
+ @param parser The parser.
+ @param count Pointer to the number of pages, set if the page list is returned.
+ @return Page object IDs, in page order, or NULL.
+ */
+extern PDInteger *PDXTableTakeSidecarPages(PDParserRef parser, PDInteger *count);
+
+/**
+ Append the object IDs of the document's pages to the parser's index sidecar, unless it holds them already. Does nothing if no sidecar is attached.
+ 
+ @param parser The parser.
+ @param kids Page object IDs, in page order.
+ @param count Number of pages.
+ */
+extern void PDXTableStoreSidecarPages(PDParserRef parser, PDInteger *kids, PDInteger count);
+
+/**
+ Detach and release the parser's index sidecar state, if any. The sidecar itself is left alone.
+ 
+ @param parser The parser.
+ */
+extern void PDXTableDestroySidecar(PDParserRef parser);
+
 /**
  Pass over an XREF entry in the input PDF.
  
@@ -274,18 +340,61 @@ extern PDArrayRef PDXTableWEntry(PDXTableRef table);
  */
 extern void PDXTableSetSizes(PDXTableRef table, unsigned char typeSize, unsigned char offsSize, unsigned char genSize);
 
+/**
+ Set the offset and gen sizes for the table to the smallest sizes that fit all of its entries.
+ */
+extern void PDXTableSetMinimalSizes(PDXTableRef table);
+
 /**
  Grow the xref table to accomodate the given cap.
+ 
+ Entries beyond the previous cap are zeroed, i.e. freed.
  */
 extern void PDXTableGrow(PDXTableRef table, PDSize cap);
 
 /**
- *  Determine the number of bytes between the first character in "<num> <num> obj" of the given object until the first character in the "<num> <num> obj" of the succeeding object in the file.
+ Enable or disable the decoded layout of the table.
+ 
+ The XRef entries are always kept packed in the table's xrefs buffer, using the field widths of the W entry, as that is the layout written to the output. A decoded table additionally keeps the type, offset, and generation number of every entry in parallel arrays, so that lookups are plain array reads rather than big-endian reassembly of variable width fields. Tables read from the input are decoded by the parser, and tables created from a decoded table are decoded as well.
+ 
+ Enabling the decoded layout decodes all existing entries in one go; disabling it releases the arrays.
+ 
+ @param table PDX table
+ @param decoded Whether the table should keep a decoded layout
+ */
+extern void PDXTableSetDecoded(PDXTableRef table, PDBool decoded);
+
+/**
+ Build the table's sorted offset index, which is used to determine the exact size of objects in the input.
+ 
+ The index holds the offsets of all used objects in the table, plus the given boundaries, which should include the positions of all XRef sections and the end of the input, so that objects preceding an XRef section or the end of the file (i.e. the last object) are bounded as well. Any existing index is replaced.
+ 
+ @note The index reflects the table at the time of the call; offsets that are updated later on (e.g. to output positions) are not taken into account.
+ 
+ @param table PDX table
+ @param boundaries Additional input offsets at which objects end
+ @param count Number of entries in boundaries
+ */
+extern void PDXTableBuildOffsetIndex(PDXTableRef table, PDOffset *boundaries, PDSize count);
+
+/**
+ Determine the number of bytes from the given input offset until the next known object, XRef section, or the end of the input.
+ 
+ @param table PDX table
+ @param offset Input offset of an object
+ @return Size in bytes, or 0 if nothing is known to follow the offset
+ */
+extern PDSize PDXTableDetermineSizeAtOffset(PDXTableRef table, PDOffset offset);
+
+/**
+ *  Determine the number of bytes between the first character in "<num> <num> obj" of the given object until the first character in the "<num> <num> obj" of the succeeding object in the file, or the succeeding XRef section or end of the file, if the offset index has boundaries for these.
+ *
+ *  If the table has no offset index, one is built (without boundaries).
  *
  *  @param table PDX table
  *  @param obid  Object whose size should be determined
  *
- *  @return Size of object in bytes
+ *  @return Size of object in bytes, or 0 if it could not be determined
  */
 extern PDSize PDXTableDetermineObjectSize(PDXTableRef table, PDInteger obid);
 
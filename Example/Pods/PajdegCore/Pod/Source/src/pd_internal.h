@@ -70,6 +70,15 @@
  */
 extern PDObjectRef PDObjectCreate(PDInteger obid, PDInteger genid);
 
+/**
+ Set up the object's instance, type and (where applicable) crypto instance, if not already done.
+
+ Objects constructed directly by the parser come with an instance; objects constructed from a definition stack are given one here.
+
+ @param object The object.
+ */
+extern void PDObjectInstantiate(PDObjectRef object);
+
 /// @name Private structs
 
 /**
@@ -192,12 +201,13 @@ struct PDObject {
     PDInteger           genid;          ///< generation id
     PDObjectClass       obclass;        ///< object class (regular, compressed, or trailer)
     PDObjectType        type;           ///< data structure of def below
-    pd_stack            def;            ///< the object content
+    pd_stack            def;            ///< the object content, or NULL if the object was constructed directly into inst
     void               *inst;           ///< instance of def, or NULL if not yet instantiated
     PDBool              hasStream;      ///< if set, object has a stream
     PDInteger           streamLen;      ///< length of stream (if one exists)
     PDInteger           extractedLen;   ///< length of extracted stream; -1 until stream has been fetched via the parser
     char               *streamBuf;      ///< the stream, if fetched via parser, otherwise an undefined value
+    PDSize              streamMapLen;   ///< if non-zero, streamBuf is a memory mapped temporary file of this many bytes, rather than a heap allocation
     PDBool              skipStream;     ///< if set, even if an object has a stream, the stream (including keywords) is skipped when written to output
     PDBool              skipObject;     ///< if set, entire object is discarded
     PDBool              deleteObject;   ///< if set, the object's XREF table slot is marked as free
@@ -206,6 +216,8 @@ struct PDObject {
     PDBool              ovrStreamAlloc; ///< if set, ovrStream will be free()d by the object after use
     char               *ovrDef;         ///< definition override
     PDInteger           ovrDefLen;      ///< take a wild guess
+    char               *updDef;         ///< in incremental updates, the definition as it was when the object was constructed, to tell whether it was modified
+    PDInteger           updDefLen;      ///< length of ^
     PDBool              encryptedDoc;   ///< if set, the object is contained in an encrypted PDF; if false, PDObjectSetStreamEncrypted is NOP
     char               *refString;      ///< reference string, cached from calls to 
     PDSynchronizer      synchronizer;   ///< synchronizer callback, called right before the object is serialized and written to the output stream
@@ -237,8 +249,9 @@ struct PDObjectStreamElement {
     PDInteger obid;                     ///< object id of element
     PDInteger offset;                   ///< offset inside object stream
     PDInteger length;                   ///< length of the (stringified) definition; only valid during a commit
-    PDObjectType type;                  ///< element object type
-    void *def;                          ///< definition; NULL if a construct has been made for this element
+    PDObjectType type;                  ///< element object type; only valid once loaded
+    void *def;                          ///< definition; NULL if a construct has been made for this element, or if it has not been loaded yet
+    PDBool loaded;                      ///< whether the definition has been scanned out of the object stream buffer
 };
 
 /**
@@ -253,6 +266,8 @@ struct PDObjectStream {
     PDStreamFilterRef filter;           ///< filter used to extract the initial raw content
     PDObjectStreamElementRef elements;  ///< n sized array of elements (non-pointered!)
     PDSplayTreeRef constructs;              ///< instances of objects (i.e. constructs)
+    char *buf;                          ///< extracted stream content, owned by ob; element definitions are scanned out of this on first access
+    PDInteger len;                      ///< length of buf
 };
 
 /**
@@ -283,6 +298,17 @@ extern PDBool PDObjectStreamParseRawObjectStream(PDObjectStreamRef obstm, char *
  */
 extern void PDObjectStreamParseExtractedObjectStream(PDObjectStreamRef obstm, char *buf);
 
+/**
+ Get the element at the given index, scanning its definition out of the stream buffer if this has not yet been done.
+ 
+ Only the header of an object stream is parsed up front; element definitions are scanned on demand, so the cost of opening a large object stream is proportional to the number of objects actually used.
+ 
+ @param obstm The object stream.
+ @param index The element index.
+ @return The element, or NULL if the index is out of bounds.
+ */
+extern PDObjectStreamElementRef PDObjectStreamGetElementAtIndex(PDObjectStreamRef obstm, PDInteger index);
+
 /**
  Commit an object stream to its associated object. 
  
@@ -402,6 +428,36 @@ typedef enum {
     PDParserStateObjectPostStream,  ///< parser is right after the endstream keyword, at the endobj keyword
 } PDParserState;
 
+/**
+ An entry in a parser cache.
+ */
+typedef struct PDParserCacheEntry *PDParserCacheEntryRef;
+struct PDParserCacheEntry {
+    PDInteger key;                  ///< (object ID << 1) | master
+    void *value;                    ///< the cached instance (retained)
+    PDParserCacheEntryRef prev;     ///< the next more recently used entry
+    PDParserCacheEntryRef next;     ///< the next less recently used entry
+    PDBool pinned;                  ///< if true, the entry is in the pinned list rather than the LRU list
+};
+
+/**
+ A least recently used cache of Pajdeg instances keyed on object ID and XREF (master or current).
+ */
+typedef struct PDParserCache PDParserCache;
+struct PDParserCache {
+    PDSplayTreeRef tree;            ///< entries keyed on (object ID << 1) | master
+    PDParserCacheEntryRef mru;      ///< most recently used entry
+    PDParserCacheEntryRef lru;      ///< least recently used entry
+    PDParserCacheEntryRef pinned;   ///< entries whose instances were found retained outside of the cache when they came up for eviction
+    PDSize count;                   ///< number of entries in the LRU list
+    PDSize pins;                    ///< number of entries in the pinned list
+    PDSize sweep;                   ///< pins count at which the pinned list is checked for entries that are no longer retained elsewhere
+    PDSize cap;                     ///< max number of entries in the LRU list; pinned entries are never evicted, and do not count towards this
+    PDSize hits;                    ///< number of lookups served from the cache
+    PDSize misses;                  ///< number of lookups that were not
+    PDSize evictions;               ///< number of entries evicted to stay within cap
+};
+
 /**
  The PDParser internal structure.
  */
@@ -416,6 +472,11 @@ struct PDParser {
     PDXTableRef cxt;                ///< current input xref table
     PDBool done;                    ///< parser has passed the last object in the input PDF
     PDSize xrefnewiter;             ///< iterator for locating unused id's for usage in master xref table
+    PDSize startxref;               ///< the input's startxref offset, which becomes the /Prev of the new xref section in incremental updates
+    PDSplayTreeRef updT;            ///< in incremental updates, the IDs of all objects written to (or deleted in) the update section; NULL otherwise
+    PDBool recovered;               ///< if true, the input's XREF data could not be read, and the xref table was reconstructed by sweeping the input for object definitions
+    struct PDXSidecar *sidecar;     ///< index sidecar state, if the parser was created with an index path; see PDXTableFetchSidecar
+    struct PDParserPacking *packing;///< object packing state, if packing was enabled; see PDParserEnablePacking
     
     // object related
     pd_stack appends;               ///< stack of objects that are meant to be appended at the end of the PDF
@@ -442,6 +503,10 @@ struct PDParser {
     PDBool success;                 ///< if true, the parser has so far succeeded at parsing the input file
     PDSplayTreeRef skipT;           ///< whenever an object is ignored due to offset discrepancy, its ID is put on the skip tree; when the last object has been parsed, if the skip tree is non-empty, the parser aborts, as it means objects were lost
     PDFontDictionaryRef mfd;        ///< Master font dictionary, containing all fonts processed so far
+    
+    // caches
+    PDParserCache obcache;          ///< objects fetched via PDParserLocateAndCreateObject
+    PDParserCache oscache;          ///< decoded and parsed object streams, keyed on their container objects
 };
 
 /**
@@ -512,7 +577,12 @@ struct PDScanner {
     
     pd_stack envStack;          ///< environment stack; e.g. root -> arb -> array -> arb -> ...
     pd_stack resultStack;       ///< results stack
-    pd_stack symbolStack;       ///< symbols stack; used to "rewind" when misinterpretations occur (e.g. for "number_or_obref" when one or two numbers)
+    PDScannerSymbolRef symbolStack; ///< symbols stack (contiguous); used to "rewind" when misinterpretations occur (e.g. for "number_or_obref" when one or two numbers)
+    PDScannerSymbolRef symbolBackup;///< symbols stack entries overwritten since the active checkpoint, kept at their original indices
+    PDInteger     symbols;      ///< number of symbols on the symbols stack
+    PDInteger     symbolsCap;   ///< capacity of the symbols stack and its backup
+    PDInteger     symbolsCheckpoint; ///< symbols stack depth at the active checkpoint
+    PDInteger     symbolsSaved; ///< lowest backed up index since the active checkpoint; symbolBackup entries in [symbolsSaved, symbolsCheckpoint) are valid
     pd_stack garbageStack;      ///< temporary allocations; only used in operator function when a symbol is regenerated from a malloc()'d string
     
     PDStreamFilterRef filter;   ///< filter, if any
@@ -758,8 +828,11 @@ struct PDState {
     char         **symbol;      ///< symbol strings
     PDInteger      symbols;     ///< number of symbols in total
     
-    PDInteger     *symindex;    ///< symbol indices (for hash)
-    short          symindices;  ///< number of index slots in total (not = `symbols`, often bigger)
+    PDInteger     *symindex;    ///< symbol indices (for hash), offset by one; 0 means no symbol has the slot
+    PDInteger     *symlen;      ///< symbol string lengths
+    short          symindices;  ///< number of index slots in total (a power of 2; not = `symbols`, often bigger)
+    unsigned int   symhashmul;  ///< perfect hash multiplier, picked by PDStateCompile
+    char           symhashshift;///< perfect hash shift, picked by PDStateCompile
     
     PDOperatorRef *symbolOp;    ///< symbol operators
     PDOperatorRef  numberOp;    ///< number operator
@@ -767,6 +840,14 @@ struct PDState {
     PDOperatorRef  fallbackOp;  ///< fallback operator
 };
 
+/**
+ Determine the index slot of a symbol with the given hash and first character in a compiled state. 
+ 
+ PDStateCompile picks the multiplier and shift so that no two symbols of the state share a slot, so a lookup is a single slot check followed by one comparison.
+ */
+#define PDStateSymbolSlot(state, hash, c0) \
+    ((((unsigned int)(unsigned short)(hash) << 8 | (unsigned char)(c0)) * (state)->symhashmul) >> (state)->symhashshift)
+
 /// @name Static Hash
 
 /**
@@ -820,6 +901,31 @@ struct PDTwinStream {
     
     char    *sidebuf;               ///< temporary buffer (e.g. for Fetch)
     
+    PDBool   mapped;                ///< if true, heap holds the entire input (a memory mapping of the input file, or a caller owned buffer), and holds == size at all times (outside of reversed mode)
+    PDBool   spooled;               ///< if true, heap is an in-memory copy of the input (a caller's buffer, or a non-seekable input), which is freed rather than unmapped
+    FILE    *spill;                 ///< temporary file holding a copy of a non-seekable input that was too large to keep in memory; fi points to it, and it is closed on destroy
+    
+    PDBool   deferpass;             ///< if true, passed through content is queued as an input range and copied kernel side (or out of the mapping) on flush, rather than written from the heap
+    PDOffset passoffs;              ///< input offset of the pending passthrough range
+    PDSize   passlen;               ///< length of the pending passthrough range; offso includes this, but the output file does not, until flushed
+    PDBool   incremental;           ///< if true, the output starts with a copy of the entire input, and only the incremental update section is written through the stream
+    
+    PDBool   prefetch;              ///< if true, a read-ahead thread is started whenever the stream switches to read/write mode
+    struct PDTwinStreamReadAhead *readahead;   ///< read-ahead state, if a read-ahead thread is running
+    struct PDTwinStreamWriteBehind *writebehind; ///< write-behind state, if a write-behind thread is running
+    
+    PDSplayTreeRef blocks;          ///< branch fetch block cache, keyed by block index (position / block size)
+    struct PDTwinStreamBlock *newest; ///< most recently used cached block
+    struct PDTwinStreamBlock *oldest; ///< least recently used cached block (first to be evicted)
+    PDSize   cacheBudget;           ///< maximum number of bytes held by the block cache; 0 disables it
+    PDSize   cacheHolds;            ///< number of bytes currently held by the block cache
+    PDSize   cacheHits;             ///< number of block lookups served from the cache
+    PDSize   cacheMisses;           ///< number of block lookups that required reading from input
+    PDSize   cacheEvictions;        ///< number of blocks evicted to stay within budget
+
+    PDIOStats stats;                ///< I/O counters; the block cache counters above are copied in on request
+    PDSize   ceiling;               ///< memory ceiling; if non-zero, the heap is shrunk back down to this size whenever it has grown beyond it and is emptied
+
     PDBool   outgrown;              ///< if true, a buffer with growth disallowed attempted to grow and failed
 };
 
@@ -831,9 +937,18 @@ struct PDTwinStream {
 struct PDPipe {
     PDBool          opened;             ///< Whether pipe has been opened or not
     PDBool          dynamicFiltering;   ///< Whether dynamic filtering is necessary; if set, the static hash filtering of filters is skipped and filters are checked for all objects
-    PDBool          typedTasks;         ///< Whether type tasks (excluding unfiltered tasks) are activated; activation results in a slight decrease in performance due to all dictionary objects needing to be resolved in order to check their Type dictionary key
+    PDBool          typedTasks;         ///< Whether type tasks (excluding unfiltered tasks) are activated; activation results in a slight decrease in performance due to the Type dictionary key of every object having to be determined, which is normally done by sniffing the raw definition (objects are only resolved when that fails, or when a type task applies)
     char           *pi;                 ///< The path of the input file
     char           *po;                 ///< The path of the output file
+    const char     *ibuf;               ///< Input buffer, if created with buffers
+    PDSize          ilen;               ///< Input buffer length
+    char          **obuf;               ///< Pointer to output buffer, if created with buffers
+    PDSize         *olen;               ///< Pointer to output buffer length
+    PDPipeOptions   options;            ///< Options given on creation
+    PDSize          cacheBudget;        ///< Byte budget for the stream's branch fetch block cache
+    PDSize          spoolThreshold;     ///< Number of bytes of non-seekable input to hold in memory before spilling to a temporary file
+    PDSize          memoryCeiling;      ///< Memory ceiling for the stream; 0 if there is none
+    PDIOStats       stats;              ///< I/O statistics, taken from the stream as it is released
     FILE           *fi;                 ///< Reader
     FILE           *fo;                 ///< Writer
     PDInteger       filterCount;        ///< Number of filters in the pipe
@@ -848,6 +963,7 @@ struct PDPipe {
 extern void PDPipeCloseFileStream(FILE *stream);
 extern FILE *PDPipeOpenInputStream(const char *path);
 extern FILE *PDPipeOpenOutputStream(const char *path);
+extern FILE *PDPipeOpenOutputBuffer(char **buf, PDSize *len);
 
 /// @name Reference
 
@@ -39,6 +39,7 @@
 #include "PDArray.h"
 #include "PDNumber.h"
 #include "PDObject.h"
+#include "pd_crypto.h"
 #include "PDArray.h"
 #include "PDDictionary.h"
 
@@ -724,6 +725,285 @@ void *PDInstanceCreateFromComplex(pd_stack *complex)
     return result;
 }
 
+//////////////////////////////////////////
+//
+// Direct construction
+//
+
+// the scanner's state machine produces pd_stack trees, which PDInstanceCreateFromComplex() then turns into instances; for dictionaries and arrays, the reader below goes straight from the scanner's buffer to instances instead; it only covers the plain subset of the syntax, and gives up on anything else (comments, escapes outside of strings, unknown keywords, ...) so that the caller can fall back to the scanner
+
+typedef struct PDDirectReader *PDDirectReaderRef;
+struct PDDirectReader {
+    PDScannerRef scanner;   ///< the scanner whose buffer is read
+    char        *buf;       ///< the buffer; may move when grown
+    PDInteger    bsize;     ///< the buffer size
+    PDInteger    i;         ///< the read offset
+};
+
+static void *PDDirectReaderValue(PDDirectReaderRef r);
+
+// make sure buf[offset] is available, growing the buffer if the scanner allows it
+static inline PDBool PDDirectReaderAvailable(PDDirectReaderRef r, PDInteger offset)
+{
+    PDScannerRef scanner = r->scanner;
+    PDInteger bsize;
+    while (r->bsize <= offset) {
+        if (scanner->fixedBuf) return false;
+        bsize = r->bsize;
+        (*scanner->bufFunc)(scanner->bufFuncInfo, scanner, &r->buf, &r->bsize, 0);
+        if (r->bsize <= bsize) return false;
+    }
+    return true;
+}
+
+// skip whitespace; on success, buf[i] is the first character of the next token
+static inline PDBool PDDirectReaderSkipWhitespace(PDDirectReaderRef r)
+{
+    do {
+        if (! PDDirectReaderAvailable(r, r->i)) return false;
+        r->i += PDOperatorSymbolGlobSpanWhitespace(&r->buf[r->i], r->bsize - r->i);
+    } while (r->i == r->bsize);
+    return true;
+}
+
+// read a run of regular characters starting at i; the run must be followed by whitespace or a delimiter
+static inline PDInteger PDDirectReaderRegular(PDDirectReaderRef r, PDInteger *start)
+{
+    *start = r->i;
+    while (true) {
+        r->i += PDOperatorSymbolGlobSpanRegular(&r->buf[r->i], r->bsize - r->i);
+        if (r->i < r->bsize) break;
+        if (! PDDirectReaderAvailable(r, r->i)) return -1;
+    }
+    return r->buf[r->i] == '\\' ? -1 : r->i - *start;
+}
+
+// read a name (at '/'), returning the offset and length of the name without the slash
+static inline PDInteger PDDirectReaderName(PDDirectReaderRef r, PDInteger *start)
+{
+    r->i++;
+    if (! PDDirectReaderSkipWhitespace(r)) return -1;
+    return PDDirectReaderRegular(r, start);
+}
+
+// read a string (at '('), up to and including the matching ')'
+static void *PDDirectReaderString(PDDirectReaderRef r)
+{
+    PDInteger start = r->i;
+    PDInteger depth = 0;
+    char c;
+    do {
+        if (! PDDirectReaderAvailable(r, r->i)) return NULL;
+        r->i += PDOperatorSymbolGlobSpanUntilDelimiter(&r->buf[r->i], r->bsize - r->i);
+        if (r->i < r->bsize) {
+            c = r->buf[r->i++];
+            if (c == '\\') r->i++;
+            else if (c == '(') depth++;
+            else if (c == ')') depth--;
+        }
+    } while (depth > 0);
+    
+    PDInteger len = r->i - start;
+    char *str = malloc(len + 1);
+    memcpy(str, &r->buf[start], len);
+    str[len] = 0;
+#ifdef PD_SUPPORT_CRYPTO
+    // see PDOperatorPushMarked in PDScannerOperate
+    char *str2;
+    pd_crypto_secure(&str2, str, len);
+    free(str);
+    str = str2;
+#endif
+    return PDStringCreate(str, strlen(str));
+}
+
+// read a hex string (at '<')
+static void *PDDirectReaderHexString(PDDirectReaderRef r)
+{
+    r->i++;
+    if (! PDDirectReaderSkipWhitespace(r) || r->buf[r->i] == '<') return NULL;
+    
+    PDInteger start = r->i;
+    while (true) {
+        r->i += PDOperatorSymbolGlobSpanUntilDelimiter(&r->buf[r->i], r->bsize - r->i);
+        if (r->i < r->bsize) break;
+        if (! PDDirectReaderAvailable(r, r->i)) return NULL;
+    }
+    if (r->buf[r->i] != '>') return NULL;
+    
+    PDInteger len = r->i - start;
+    char *hex = malloc(len + 3);
+    hex[0] = '<';
+    memcpy(&hex[1], &r->buf[start], len);
+    hex[len+1] = '>';
+    hex[len+2] = 0;
+    r->i++;
+    return PDStringCreateWithHexString(hex);
+}
+
+// read an array (at '[')
+static void *PDDirectReaderArray(PDDirectReaderRef r)
+{
+    PDArrayRef array = PDArrayCreateWithCapacity(4);
+    void *value;
+    
+    r->i++;
+    while (PDDirectReaderSkipWhitespace(r)) {
+        if (r->buf[r->i] == ']') {
+            r->i++;
+            return array;
+        }
+        value = PDDirectReaderValue(r);
+        if (value == NULL) break;
+        PDArrayAppend(array, value);
+        PDRelease(value);
+    }
+    
+    PDRelease(array);
+    return NULL;
+}
+
+// read a dictionary (at '<<')
+static void *PDDirectReaderDictionary(PDDirectReaderRef r)
+{
+    PDDictionaryRef dict = PDDictionaryCreate();
+    PDInteger start, len;
+    char *key;
+    void *value;
+    
+    r->i += 2;
+    while (PDDirectReaderSkipWhitespace(r)) {
+        if (r->buf[r->i] == '>') {
+            r->i++;
+            if (PDDirectReaderSkipWhitespace(r) && r->buf[r->i] == '>') {
+                r->i++;
+                return dict;
+            }
+            break;
+        }
+        if (r->buf[r->i] != '/') break;
+        
+        len = PDDirectReaderName(r, &start);
+        if (len < 1) break;
+        // the buffer may move while reading the value, so the key is copied out first
+        key = malloc(len + 1);
+        memcpy(key, &r->buf[start], len);
+        key[len] = 0;
+        
+        value = PDDirectReaderValue(r);
+        if (value) {
+            PDDictionarySet(dict, key, value);
+            PDRelease(value);
+        }
+        free(key);
+        if (value == NULL) break;
+    }
+    
+    PDRelease(dict);
+    return NULL;
+}
+
+// read a number, a reference (two integers followed by R), or one of the keywords true, false and null
+static void *PDDirectReaderKeyword(PDDirectReaderRef r)
+{
+    char num[32], gen[32];
+    PDInteger start, len, i;
+    PDBool numeric = true, real = false;
+    char c;
+    
+    len = PDDirectReaderRegular(r, &start);
+    if (len < 1 || len >= 32) return NULL;
+    memcpy(num, &r->buf[start], len);
+    num[len] = 0;
+    
+    for (i = 0; numeric && i < len; i++) {
+        c = num[i];
+        PDSymbolUpdateNumeric(numeric, real, c, i == 0);
+    }
+    
+    if (! numeric) {
+        if (0 == strcmp(num, "true"))  return PDNumberCreateWithBool(true);
+        if (0 == strcmp(num, "false")) return PDNumberCreateWithBool(false);
+        if (0 == strcmp(num, "null"))  return PDRetain(PDNullObject);
+        return NULL;
+    }
+    
+    if (! real) {
+        // this may be the object ID of a reference, in which case we see the generation ID and R next
+        PDInteger rewind = r->i;
+        if (PDDirectReaderSkipWhitespace(r) && (len = PDDirectReaderRegular(r, &start)) > 0 && len < 32) {
+            memcpy(gen, &r->buf[start], len);
+            gen[len] = 0;
+            numeric = true;
+            real = false;
+            for (i = 0; numeric && i < len; i++) {
+                c = gen[i];
+                PDSymbolUpdateNumeric(numeric, real, c, i == 0);
+            }
+            if (numeric && ! real && PDDirectReaderSkipWhitespace(r) && (len = PDDirectReaderRegular(r, &start)) == 1 && r->buf[start] == 'R') {
+                return PDReferenceCreate(PDIntegerFromString(num), PDIntegerFromString(gen));
+            }
+        }
+        r->i = rewind;
+    }
+    
+    return PDNumberCreateWithCString(num);
+}
+
+static void *PDDirectReaderValue(PDDirectReaderRef r)
+{
+    PDInteger start, len;
+    char *name;
+    
+    if (! PDDirectReaderSkipWhitespace(r)) return NULL;
+    
+    switch (r->buf[r->i]) {
+        case '/':
+            len = PDDirectReaderName(r, &start);
+            if (len < 1) return NULL;
+            name = malloc(len + 2);
+            name[0] = '/';
+            memcpy(&name[1], &r->buf[start], len);
+            name[len+1] = 0;
+            return PDStringCreateWithName(name);
+            
+        case '(':
+            return PDDirectReaderString(r);
+            
+        case '[':
+            return PDDirectReaderArray(r);
+            
+        case '<':
+            if (PDDirectReaderAvailable(r, r->i + 1) && r->buf[r->i+1] == '<')
+                return PDDirectReaderDictionary(r);
+            return PDDirectReaderHexString(r);
+            
+        default:
+            if (PDOperatorSymbolGlob[(unsigned char)r->buf[r->i]] == PDOperatorSymbolGlobDelimiter) 
+                return NULL;
+            return PDDirectReaderKeyword(r);
+    }
+}
+
+void *PDInstanceCreateFromBuffer(PDScannerRef scanner, PDInteger *offset)
+{
+    struct PDDirectReader r = (struct PDDirectReader) {scanner, scanner->buf, scanner->bsize, *offset};
+    void *result = NULL;
+    
+    if (PDDirectReaderSkipWhitespace(&r)) {
+        if (r.buf[r.i] == '[' || (r.buf[r.i] == '<' && PDDirectReaderAvailable(&r, r.i + 1) && r.buf[r.i+1] == '<')) {
+            result = PDDirectReaderValue(&r);
+        }
+    }
+    
+    // the buffer may have been grown even if we failed
+    scanner->buf = r.buf;
+    scanner->bsize = r.bsize;
+    
+    if (result) *offset = r.i;
+    return result;
+}
+
 PDObjectType PDObjectTypeFromIdentifier(PDID identifier)
 {
     PDAssert(typeTable); // crash = must pd_pdf_conversion_use() first
@@ -143,6 +143,20 @@ extern char *PDStringFromComplex(pd_stack *complex);
  */
 extern void *PDInstanceCreateFromComplex(pd_stack *complex);
 
+/**
+ *  Construct a dictionary or array instance directly from the scanner's buffer, starting at the given offset, without going through the scanner's state machine.
+ *
+ *  The buffer is grown as needed, unless it is fixed. If the value at the offset is not a dictionary or array, or if it uses syntax that the direct path does not handle (e.g. comments), NULL is returned, and the scanner should be used instead.
+ *
+ *  @note Returned entry must be PDRelease()'d
+ *
+ *  @param scanner The scanner whose buffer should be read
+ *  @param offset  Pointer to the buffer offset; on success, it is moved past the value
+ *
+ *  @return A PDDictionary or PDArray instance, or NULL
+ */
+extern void *PDInstanceCreateFromBuffer(PDScannerRef scanner, PDInteger *offset);
+
 /**
  Determine object type from identifier.
  
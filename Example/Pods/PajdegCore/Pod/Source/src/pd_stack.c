@@ -22,6 +22,8 @@
 // THE SOFTWARE.
 //
 
+#include <pthread.h>
+
 #include "pd_stack.h"
 #include "pd_internal.h"
 #include "PDEnv.h"
@@ -41,9 +43,81 @@ void pd_stack_set_global_preserve_flag(PDBool preserve)
         pd_stack_dealloc = preserve ? &pd_stack_preserve : &free;
 }
 
+//
+// node allocation
+//
+
+// popped and destroyed nodes are kept in a small per-thread cache and handed out again, rather than going through free() and malloc() every time; the cache is bounded, so long pipes don't hold on to more than PD_STACK_CACHE_NODES spare nodes per thread
+
+#define PD_STACK_CACHE_NODES 4096
+
+typedef struct pd_stack_cache *pd_stack_cache;
+struct pd_stack_cache {
+    pd_stack    nodes;  ///< the cached nodes, linked via prev
+    PDInteger   count;  ///< the number of cached nodes
+};
+
+static pthread_key_t pd_stack_cache_key;
+static pthread_once_t pd_stack_cache_once = PTHREAD_ONCE_INIT;
+
+static void pd_stack_cache_destroy(void *info)
+{
+    pd_stack_cache cache = info;
+    pd_stack s;
+    while (NULL != (s = cache->nodes)) {
+        cache->nodes = s->prev;
+        free(s);
+    }
+    free(cache);
+}
+
+static void pd_stack_cache_setup(void)
+{
+    pthread_key_create(&pd_stack_cache_key, pd_stack_cache_destroy);
+}
+
+static inline pd_stack_cache pd_stack_get_cache()
+{
+    pthread_once(&pd_stack_cache_once, pd_stack_cache_setup);
+    pd_stack_cache cache = pthread_getspecific(pd_stack_cache_key);
+    if (cache == NULL) {
+        cache = calloc(1, sizeof(struct pd_stack_cache));
+        pthread_setspecific(pd_stack_cache_key, cache);
+    }
+    return cache;
+}
+
+static inline pd_stack pd_stack_alloc_node()
+{
+    pd_stack_cache cache = pd_stack_get_cache();
+    pd_stack s = cache->nodes;
+    if (s == NULL) return malloc(sizeof(struct pd_stack));
+    cache->nodes = s->prev;
+    cache->count--;
+    return s;
+}
+
+static inline void pd_stack_release_node(pd_stack_cache cache, pd_stack s)
+{
+    if (cache->count >= PD_STACK_CACHE_NODES) {
+        free(s);
+        return;
+    }
+    s->prev = cache->nodes;
+    cache->nodes = s;
+    cache->count++;
+}
+
+static inline void pd_stack_free_node(pd_stack s)
+{
+    // in preserve mode, popped nodes remain part of their stack
+    if (pd_stack_dealloc == &pd_stack_preserve) return;
+    pd_stack_release_node(pd_stack_get_cache(), s);
+}
+
 void pd_stack_push_identifier(pd_stack *stack, PDID identifier)
 {
-    pd_stack s = malloc(sizeof(struct pd_stack));
+    pd_stack s = pd_stack_alloc_node();
     s->prev = *stack;
     s->info = identifier;
     s->type = PD_STACK_ID;
@@ -52,7 +126,7 @@ void pd_stack_push_identifier(pd_stack *stack, PDID identifier)
 
 void pd_stack_push_key(pd_stack *stack, char *key)
 {
-    pd_stack s = malloc(sizeof(struct pd_stack));
+    pd_stack s = pd_stack_alloc_node();
     s->prev = *stack;
     s->info = key;//strdup(key); free(key);// we can't do the strdup/free trick, ever, because it breaks any code that uses pd_stack as a garbage collector
     s->type = PD_STACK_STRING;
@@ -61,7 +135,7 @@ void pd_stack_push_key(pd_stack *stack, char *key)
 
 void pd_stack_push_freeable(pd_stack *stack, void *freeable)
 {
-    pd_stack s = malloc(sizeof(struct pd_stack));
+    pd_stack s = pd_stack_alloc_node();
     s->prev = *stack;
     s->info = freeable;
     s->type = PD_STACK_FREEABLE;
@@ -70,7 +144,7 @@ void pd_stack_push_freeable(pd_stack *stack, void *freeable)
 
 void pd_stack_push_stack(pd_stack *stack, pd_stack pstack)
 {
-    pd_stack s = malloc(sizeof(struct pd_stack));
+    pd_stack s = pd_stack_alloc_node();
     s->prev = *stack;
     s->info = pstack;
     s->type = PD_STACK_STACK;
@@ -87,7 +161,7 @@ void pd_stack_unshift_stack(pd_stack *stack, pd_stack sstack)
     
     for (vtail = *stack; vtail->prev; vtail = vtail->prev) ;
 
-    pd_stack s = malloc(sizeof(struct pd_stack));
+    pd_stack s = pd_stack_alloc_node();
     s->prev = NULL;
     s->info = sstack;
     s->type = PD_STACK_STACK;
@@ -97,7 +171,7 @@ void pd_stack_unshift_stack(pd_stack *stack, pd_stack sstack)
 void pd_stack_push_object(pd_stack *stack, void *ob)
 {
     PDTYPE_ASSERT(ob);
-    pd_stack s = malloc(sizeof(struct pd_stack));
+    pd_stack s = pd_stack_alloc_node();
     s->prev = *stack;
     s->info = ob;
     s->type = PD_STACK_PDOB;
@@ -111,7 +185,7 @@ PDID pd_stack_pop_identifier(pd_stack *stack)
     PDAssert(popped->type == PD_STACK_ID);
     *stack = popped->prev;
     PDID identifier = popped->info;
-    pd_stack_dealloc(popped);
+    pd_stack_free_node(popped);
     return identifier;
 }
 
@@ -131,7 +205,7 @@ void pd_stack_assert_expected_key(pd_stack *stack, const char *key)
     }
     
     *stack = popped->prev;
-    pd_stack_dealloc(popped);
+    pd_stack_free_node(popped);
 }
 
 void pd_stack_assert_expected_int(pd_stack *stack, PDInteger i)
@@ -146,7 +220,7 @@ void pd_stack_assert_expected_int(pd_stack *stack, PDInteger i)
     
     *stack = popped->prev;
     pd_stack_dealloc(got);
-    pd_stack_dealloc(popped);
+    pd_stack_free_node(popped);
 }
 
 PDSize pd_stack_pop_size(pd_stack *stack)
@@ -158,7 +232,7 @@ PDSize pd_stack_pop_size(pd_stack *stack)
     char *key = popped->info;
     PDSize st = atol(key);
     pd_stack_dealloc(key);
-    pd_stack_dealloc(popped);
+    pd_stack_free_node(popped);
     return st;
 }
 
@@ -171,7 +245,7 @@ PDInteger pd_stack_pop_int(pd_stack *stack)
     char *key = popped->info;
     PDInteger st = atol(key);
     pd_stack_dealloc(key);
-    pd_stack_dealloc(popped);
+    pd_stack_free_node(popped);
     return st;
 }
 
@@ -189,7 +263,7 @@ char *pd_stack_pop_key(pd_stack *stack)
     PDAssert(popped->type == PD_STACK_STRING);
     *stack = popped->prev;
     char *key = popped->info;
-    pd_stack_dealloc(popped);
+    pd_stack_free_node(popped);
     return key;
 }
 
@@ -200,7 +274,7 @@ pd_stack pd_stack_pop_stack(pd_stack *stack)
     PDAssert(popped->type == PD_STACK_STACK);
     *stack = popped->prev;
     pd_stack pstack = popped->info;
-    pd_stack_dealloc(popped);
+    pd_stack_free_node(popped);
     return pstack;
 }
 
@@ -211,7 +285,7 @@ void *pd_stack_pop_object(pd_stack *stack)
     PDAssert(popped->type == PD_STACK_PDOB);
     *stack = popped->prev;
     void *ob = popped->info;
-    pd_stack_dealloc(popped);
+    pd_stack_free_node(popped);
     return ob;
 }
 
@@ -222,7 +296,7 @@ void *pd_stack_pop_freeable(pd_stack *stack)
     PDAssert(popped->type == PD_STACK_FREEABLE);
     *stack = popped->prev;
     void *key = popped->info;
-    pd_stack_dealloc(popped);
+    pd_stack_free_node(popped);
     return key;
 }
 
@@ -300,11 +374,11 @@ void pd_stack_replace_info_object(pd_stack stack, char type, void *info)
 void pd_stack_destroy_internal(pd_stack stack)
 {
     pd_stack p;
+    pd_stack_cache cache = stack ? pd_stack_get_cache() : NULL;
     while (stack) {
-        //printf("-stack %p\n", stack);
         p = stack->prev;
         pd_stack_free_info(stack);
-        free(stack);
+        pd_stack_release_node(cache, stack);
         stack = p;
     }
 }
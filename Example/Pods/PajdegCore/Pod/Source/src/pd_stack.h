@@ -35,6 +35,8 @@
  
  The pd_stack works like any other stack, except it has some amount of awareness about certain object types. 
  
+ Popped and destroyed stack nodes are recycled through a bounded, per-thread cache, so pushing and popping rarely reaches malloc() or free(). Unlike the global preserve flag, the cache is thread safe; nodes may be freed on a different thread than the one they were allocated on.
+ 
  @{
 */
 
@@ -311,7 +313,7 @@ extern void pd_stack_show(pd_stack stack);
 /** @} */
 
 /**
- The global deallocator for stacks. Defaults to the built-in free() function, but is overridden when global preserve flag is set.
+ The global deallocator for stack content, such as popped keys. Defaults to the built-in free() function, but is overridden when global preserve flag is set.
  
  @see pd_stack_set_global_preserve_flag
  */
@@ -0,0 +1,87 @@
+//
+// pd_work_queue.c
+//
+// Copyright (c) 2012 - 2015 Karl-Johan Alm (http://github.com/kallewoof)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "pd_work_queue.h"
+#include "pd_internal.h"
+
+typedef struct pd_work_queue pd_work_queue;
+struct pd_work_queue {
+    pthread_mutex_t     lock;   ///< lock guarding next
+    pd_work_queue_func  func;   ///< the job function
+    void               *info;   ///< the info object
+    PDInteger           count;  ///< number of jobs
+    PDInteger           next;   ///< index of the next job to be run
+};
+
+static void *pd_work_queue_main(void *info)
+{
+    pd_work_queue *queue = info;
+    PDInteger i;
+    
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        i = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+        if (i >= queue->count) break;
+        queue->func(queue->info, i);
+    }
+    
+    return NULL;
+}
+
+void pd_work_queue_run(pd_work_queue_func func, void *info, PDInteger count, PDInteger bytes, PDInteger bytesPerThread)
+{
+    pthread_t threads[PD_WORK_QUEUE_THREADS];
+    pd_work_queue queue;
+    PDInteger spawn, spawned, i;
+    
+    spawn = bytes / bytesPerThread;
+    if (spawn > count - 1) spawn = count - 1;
+    if (spawn > PD_WORK_QUEUE_THREADS - 1) spawn = PD_WORK_QUEUE_THREADS - 1;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus > 0 && spawn > cpus - 1) spawn = cpus - 1;
+    
+    queue.func = func;
+    queue.info = info;
+    queue.count = count;
+    queue.next = 0;
+    pthread_mutex_init(&queue.lock, NULL);
+    
+    for (spawned = 0; spawned < spawn; spawned++) {
+        if (pthread_create(&threads[spawned], NULL, pd_work_queue_main, &queue)) {
+            PDNotice("unable to start work queue thread");
+            break;
+        }
+    }
+    
+    pd_work_queue_main(&queue);
+    
+    for (i = 0; i < spawned; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&queue.lock);
+}
@@ -0,0 +1,74 @@
+//
+// pd_work_queue.h
+//
+// Copyright (c) 2012 - 2015 Karl-Johan Alm (http://github.com/kallewoof)
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+/**
+ @file pd_work_queue.h Work queue header file.
+ 
+ @ingroup pd_work_queue
+ 
+ @defgroup pd_work_queue pd_work_queue
+ 
+ @brief Minimal parallel for, used to spread independent jobs (such as decoding XRef sections, or compressing object streams) across a few threads.
+ 
+ @ingroup PDALGO
+ 
+ Threads are only started if there is enough work to make it worthwhile, and the calling thread always takes part in the work. Jobs must not touch anything that isn't thread safe, which includes pd_stack preserve mode and the autorelease pool.
+ 
+ @{
+ */
+
+#ifndef INCLUDED_pd_work_queue_h
+#define INCLUDED_pd_work_queue_h
+
+#include "PDDefines.h"
+
+/**
+ The maximum number of threads working on a queue, including the calling thread.
+ */
+#define PD_WORK_QUEUE_THREADS   8
+
+/**
+ A job function. 
+ 
+ @param info The info object passed to pd_work_queue_run().
+ @param index The index of the job, in [0, count).
+ */
+typedef void (*pd_work_queue_func)(void *info, PDInteger index);
+
+/**
+ Run count jobs, in parallel if there is enough data to make it worthwhile, and return once all of them are done. 
+ 
+ One additional thread is started for every bytesPerThread bytes, up to one thread per job, PD_WORK_QUEUE_THREADS threads, or the number of processors, whichever is lowest. If threads can't be started, the calling thread simply ends up doing more of the work.
+ 
+ @param func The job function.
+ @param info Info object passed to func.
+ @param count The number of jobs.
+ @param bytes The total amount of data the jobs work on.
+ @param bytesPerThread The minimum number of bytes per additional thread.
+ */
+extern void pd_work_queue_run(pd_work_queue_func func, void *info, PDInteger count, PDInteger bytes, PDInteger bytesPerThread);
+
+#endif
+
+/** @} */
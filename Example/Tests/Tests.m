@@ -14,12 +14,237 @@
 #import "PDPipe.h"
 #import "PDParser.h"
 #import "PDCatalog.h"
+#import "PDOperator.h"
+#import "PDTask.h"
+#import "PDObject.h"
+#import "PDDictionary.h"
+#import "PDNumber.h"
+#import "PDString.h"
 #import "NSArray+Sampling.h"
 
 // not sure what to do here; there are a ton of PDFs, some private, some copyrighted/purchased, that the library is tested against; can't likely require travis to download a bunch of PDFs online either..
 #define PAJDEG_PDFS @"/Users/user/Workspace/pajdeg-sample-pdfs/"
 #define PAJDEG_INFS @"/Users/user/Workspace/pajdeg-inf-pdfs/"
 
+// the symbol glob span functions classify 16 or 32 bytes at a time where SSE2/AVX2 or NEON are available; they must agree with the plain per-byte definitions below
+static PDSize PDTestScalarSpan(const char *buf, PDSize len, int mode)
+{
+    PDSize i;
+    unsigned char c;
+    char glob;
+    for (i = 0; i < len; i++) {
+        c = (unsigned char)buf[i];
+        glob = PDOperatorSymbolGlob[c];
+        if (mode == 0 ? glob != PDOperatorSymbolGlobWhitespace
+            : mode == 1 ? glob != PDOperatorSymbolGlobRegular || c == '\\'
+            : mode == 2 ? glob == PDOperatorSymbolGlobDelimiter || c == '\\'
+            : c == '\r' || c == '\n' || c == '\\') break;
+    }
+    return i;
+}
+
+static PDSize (*PDTestSpans[4])(const char *, PDSize) = {
+    PDOperatorSymbolGlobSpanWhitespace,
+    PDOperatorSymbolGlobSpanRegular,
+    PDOperatorSymbolGlobSpanUntilDelimiter,
+    PDOperatorSymbolGlobSpanUntilNewline,
+};
+
+// compare every span function with the scalar definition, from every offset in buf, and for a few truncated lengths
+static PDInteger PDTestSpanMismatches(const char *buf, PDSize len)
+{
+    PDInteger mismatches = 0;
+    PDSize from, end;
+    int mode;
+    for (end = len; end + 4 > len && end > 0; end--) 
+        for (from = 0; from <= end; from++) 
+            for (mode = 0; mode < 4; mode++) 
+                if (PDTestSpans[mode](&buf[from], end - from) != PDTestScalarSpan(&buf[from], end - from, mode)) 
+                    mismatches++;
+    return mismatches;
+}
+
+static const char *PDTestSpanSamples[] = {
+    "(a string with \\(escaped\\) parens, (nested (twice) ) parens and a trailing \\\\)",
+    "(octal \\101\\102, \\n escapes and a line\\\ncontinuation)",
+    "% a comment that runs to the end of the line\r\n/Next",
+    "%comment\rwith a lone carriage return\n",
+    "<< /Type /Page /Contents 4 0 R /Name#20With#20Escapes true >>",
+    " \t\r\n\f  \t  ",
+    "[1 2.5 -3 (x) <414243>]",
+    NULL
+};
+
+// strings and comments preceded by runs of every length up to two 32 byte blocks, so that every part of them lands on a block boundary somewhere
+static PDInteger PDTestSpanSampleMismatches(void)
+{
+    char buf[256];
+    const char fillers[] = " x";
+    PDInteger mismatches = 0;
+    PDSize pad, len;
+    for (int s = 0; PDTestSpanSamples[s]; s++) {
+        len = strlen(PDTestSpanSamples[s]);
+        for (int f = 0; f < 2; f++) {
+            for (pad = 0; pad <= 65; pad++) {
+                memset(buf, fillers[f], pad);
+                memcpy(&buf[pad], PDTestSpanSamples[s], len);
+                mismatches += PDTestSpanMismatches(buf, pad + len);
+            }
+        }
+    }
+    return mismatches;
+}
+
+// every byte value, at every position within (and just past) two 32 byte blocks
+static PDInteger PDTestSpanByteMismatches(void)
+{
+    char buf[80];
+    const char fillers[] = " x";
+    PDInteger mismatches = 0;
+    int mode;
+    for (int f = 0; f < 2; f++) {
+        for (int c = 0; c < 256; c++) {
+            for (int pos = 0; pos <= 65; pos++) {
+                memset(buf, fillers[f], sizeof(buf));
+                buf[pos] = (char)c;
+                for (mode = 0; mode < 4; mode++) 
+                    if (PDTestSpans[mode](buf, sizeof(buf)) != PDTestScalarSpan(buf, sizeof(buf), mode)) 
+                        mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+// a small PDF with a catalog, a page tree with one page, the page's content stream and an info dictionary; the xref is a table in the PDF 1.4 version, and an uncompressed /XRef stream in the PDF 1.5 version; the caller must free() the result
+static char *PDTestCreatePDF(PDBool xrefStream, PDSize *length)
+{
+    static const char *objects[] = {
+        "<< /Type /Catalog /Pages 2 0 R >>",
+        "<< /Type /Pages /Kids [3 0 R] /Count 1 >>",
+        "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Contents 5 0 R >>",
+        "<< /Producer (Pajdeg tests) >>",
+        "<< /Length 17 >>\nstream\n0 0 m 100 100 l S\nendstream",
+    };
+    PDSize offsets[7];
+    char *buf = malloc(2048);
+    PDSize len = sprintf(buf, "%%PDF-%s\n", xrefStream ? "1.5" : "1.4");
+    int i;
+
+    for (i = 1; i <= 5; i++) {
+        offsets[i] = len;
+        len += sprintf(&buf[len], "%d 0 obj\n%s\nendobj\n", i, objects[i-1]);
+    }
+    offsets[6] = len;
+
+    if (xrefStream) {
+        // 1 byte type, 4 byte offset and 2 byte generation per entry; the stream itself is object 6
+        len += sprintf(&buf[len], "6 0 obj\n<< /Type /XRef /Size 7 /W [1 4 2] /Root 1 0 R /Info 4 0 R /Length 49 >>\nstream\n");
+        for (i = 0; i <= 6; i++) {
+            buf[len++] = i > 0;
+            buf[len++] = i > 0 ? offsets[i] >> 24 : 0;
+            buf[len++] = i > 0 ? offsets[i] >> 16 : 0;
+            buf[len++] = i > 0 ? offsets[i] >> 8 : 0;
+            buf[len++] = i > 0 ? offsets[i] : 0;
+            buf[len++] = i > 0 ? 0 : 0xff;
+            buf[len++] = i > 0 ? 0 : 0xff;
+        }
+        len += sprintf(&buf[len], "\nendstream\nendobj\n");
+    } else {
+        len += sprintf(&buf[len], "xref\n0 6\n0000000000 65535 f \n");
+        for (i = 1; i <= 5; i++)
+            len += sprintf(&buf[len], "%010zu 00000 n \n", (size_t)offsets[i]);
+        len += sprintf(&buf[len], "trailer\n<< /Size 6 /Root 1 0 R /Info 4 0 R >>\n");
+    }
+
+    len += sprintf(&buf[len], "startxref\n%zu\n%%%%EOF\n", (size_t)offsets[6]);
+    *length = len;
+    return buf;
+}
+
+static PDTaskResult PDTestMarkObject(PDPipeRef pipe, PDTaskRef task, PDObjectRef object, void *info)
+{
+    PDDictionarySet(PDObjectGetDictionary(object), "PajdegTest", PDNumberWithInteger(42));
+    return PDTaskDone;
+}
+
+static PDTaskResult PDTestInspectObject(PDPipeRef pipe, PDTaskRef task, PDObjectRef object, void *info)
+{
+    PDDictionaryGet(PDObjectGetDictionary(object), "Type");
+    return PDTaskDone;
+}
+
+// pass a PDF in memory through a pipe with the given options, marking the page object (3) and looking at, but not changing, the catalog and the page tree; the caller must free() the result
+static char *PDTestPipePDF(const char *input, PDSize inputLength, PDPipeOptions options, PDSize *outputLength)
+{
+    char *output = NULL;
+    PDPipeRef pipe = PDPipeCreateWithBuffersAndOptions(input, inputLength, &output, outputLength, options);
+    if (pipe == NULL) return NULL;
+
+    PDTaskRef tasks[] = {
+        PDTaskCreateMutatorForObject(3, PDTestMarkObject),
+        PDTaskCreateMutatorForPropertyType(PDPropertyRootObject, PDTestInspectObject),
+        PDTaskCreateMutatorForObject(2, PDTestInspectObject),
+    };
+    for (int i = 0; i < 3; i++) {
+        PDPipeAddTask(pipe, tasks[i]);
+        PDRelease(tasks[i]);
+    }
+
+    if (PDPipeExecute(pipe) < 0) {
+        free(output);
+        output = NULL;
+    }
+    PDRelease(pipe);
+    return output;
+}
+
+// the offset following the last startxref keyword, or -1 if there is none
+static long PDTestStartXRef(const char *buf, PDSize len)
+{
+    for (PDSize i = len > 9 ? len - 9 : 0; i > 0; i--)
+        if (! memcmp(&buf[i], "startxref", 9))
+            return strtol(&buf[i + 9], NULL, 10);
+    return -1;
+}
+
+// the value of the first /Prev key in the NUL-terminated buf, or -1 if there is none
+static long PDTestPrev(const char *buf)
+{
+    const char *prev = strstr(buf, "/Prev ");
+    return prev ? strtol(&prev[6], NULL, 10) : -1;
+}
+
+// the IDs of the objects defined at the start of a line in the NUL-terminated buf, except for xref streams; at most max IDs are stored, but all are counted
+static PDInteger PDTestObjectIDs(const char *buf, PDInteger *obids, PDInteger max)
+{
+    PDInteger count = 0;
+    long obid, genid;
+    int n;
+
+    for (const char *p = buf; *p; p++) {
+        if (p > buf && p[-1] != '\n' && p[-1] != '\r') continue;
+        n = 0;
+        if (sscanf(p, "%ld %ld obj%n", &obid, &genid, &n) < 2 || n == 0) continue;
+        if (! strncmp(&p[n], "\n<< /Type /XRef", 15)) continue;
+        if (count < max) obids[count] = obid;
+        count++;
+    }
+    return count;
+}
+
+// the definition of the given object as seen by a parser, or NULL if the object could not be located; the caller must free() the result
+static char *PDTestObjectDefinition(PDParserRef parser, PDInteger obid)
+{
+    char *def = NULL;
+    PDObjectRef ob = PDParserLocateAndCreateObject(parser, obid, true);
+    if (ob) {
+        PDObjectGenerateDefinition(ob, &def, 0);
+        PDRelease(ob);
+    }
+    return def;
+}
+
 SpecBegin(InitialSpecs)
 
 NSFileManager *_fm = [NSFileManager defaultManager];
@@ -197,6 +422,108 @@ sharedExamplesFor(@"a PDF with annotations created", ^(NSDictionary *data) {
     }
 });
 
+describe(@"symbol glob spans", ^{
+    beforeAll(^{
+        PDOperatorSymbolGlobSetup();
+    });
+    
+    it(@"should match the scalar scanner on strings and comments", ^{
+        expect(PDTestSpanSampleMismatches()).to.equal(0);
+    });
+    
+    it(@"should stop at every byte value at every block position", ^{
+        expect(PDTestSpanByteMismatches()).to.equal(0);
+    });
+});
+
+describe(@"incremental updates", ^{
+    for (int xrefStream = 0; xrefStream < 2; xrefStream++) {
+        it(xrefStream ? @"should append only the changed object to a PDF with an xref stream" : @"should append only the changed object to a PDF with an xref table", ^{
+            PDSize inputLength, outputLength;
+            PDInteger obids[4];
+            char *input = PDTestCreatePDF(xrefStream, &inputLength);
+            char *output = PDTestPipePDF(input, inputLength, PDPipeOptionIncrementalUpdate, &outputLength);
+            expect(output != NULL).to.beTruthy();
+            if (output == NULL) {
+                free(input);
+                return;
+            }
+            
+            // the input is left as it is, and followed by the page object and an xref section pointing back at the original one
+            expect(outputLength).to.beGreaterThan(inputLength);
+            expect(memcmp(output, input, inputLength)).to.equal(0);
+            expect(PDTestObjectIDs(&output[inputLength], obids, 4)).to.equal(1);
+            expect(obids[0]).to.equal(3);
+            expect(PDTestPrev(&output[inputLength])).to.equal(PDTestStartXRef(input, inputLength));
+            
+            PDPipeRef pipe = PDPipeCreateWithBuffers(output, outputLength, NULL, NULL);
+            expect(PDPipePrepare(pipe)).to.beTruthy();
+            char *def = PDTestObjectDefinition(PDPipeGetParser(pipe), 3);
+            expect(def && strstr(def, "/PajdegTest 42")).to.beTruthy();
+            free(def);
+            PDRelease(pipe);
+            
+            free(input);
+            free(output);
+        });
+    }
+});
+
+describe(@"object packing", ^{
+    it(@"should pack a PDF 1.4 document into object streams that read back", ^{
+        PDSize inputLength, outputLength;
+        PDInteger obids[8], count, i;
+        char *input = PDTestCreatePDF(false, &inputLength);
+        char *output = PDTestPipePDF(input, inputLength, PDPipeOptionPackObjects, &outputLength);
+        expect(output != NULL).to.beTruthy();
+        if (output == NULL) {
+            free(input);
+            return;
+        }
+        
+        // the objects without streams (1-4) are only found in object streams, and the xref table is replaced by a compressed xref stream
+        count = PDTestObjectIDs(output, obids, 8);
+        expect(count).to.beLessThanOrEqualTo(8);
+        for (i = 0; i < count && i < 8; i++) 
+            expect(obids[i]).to.beGreaterThan(4);
+        expect(strstr(output, "/Type /ObjStm") != NULL).to.beTruthy();
+        expect(strstr(output, "/Type /XRef") != NULL).to.beTruthy();
+        expect(strstr(output, "trailer") == NULL).to.beTruthy();
+        
+        PDPipeRef inputPipe = PDPipeCreateWithBuffers(input, inputLength, NULL, NULL);
+        PDPipeRef outputPipe = PDPipeCreateWithBuffers(output, outputLength, NULL, NULL);
+        expect(PDPipePrepare(inputPipe)).to.beTruthy();
+        expect(PDPipePrepare(outputPipe)).to.beTruthy();
+        
+        // the packed objects are located via the compressed xref, and every object resolves to what it was, except for the marked page object and the catalog
+        for (i = 1; i <= 4; i++) 
+            expect(PDParserGetContainerObjectIDForObject(PDPipeGetParser(outputPipe), i)).to.beGreaterThan(5);
+        expect(PDParserGetContainerObjectIDForObject(PDPipeGetParser(outputPipe), 5)).to.equal(-1);
+        for (i = 2; i <= 5; i++) {
+            char *original = PDTestObjectDefinition(PDPipeGetParser(inputPipe), i);
+            char *packed = PDTestObjectDefinition(PDPipeGetParser(outputPipe), i);
+            expect(original != NULL && packed != NULL).to.beTruthy();
+            if (original && packed) {
+                if (i == 3) expect(strstr(packed, "/PajdegTest 42") != NULL).to.beTruthy();
+                else expect(strcmp(original, packed)).to.equal(0);
+            }
+            free(original);
+            free(packed);
+        }
+        
+        // object streams need PDF 1.5, which the catalog now declares
+        PDDictionaryRef catalog = PDObjectGetDictionary(PDParserGetRootObject(PDPipeGetParser(outputPipe)));
+        PDStringRef version = PDDictionaryGetString(catalog, "Version");
+        expect(version != NULL).to.beTruthy();
+        if (version) expect(@(PDStringNameValue(version, false))).to.equal(@"/1.5");
+        expect(PDDictionaryGet(catalog, "Pages") != NULL).to.beTruthy();
+        
+        PDRelease(inputPipe);
+        PDRelease(outputPipe);
+        free(input);
+        free(output);
+    });
+});
 
 describe(@"PDF behaviors", ^{
     NSString *path = PAJDEG_PDFS;
@@ -83,7 +83,7 @@ typedef PDTaskResult (^PDIObjectOperation)(PDISession *session, PDIObject *objec
  @param sourcePDFPath   The input PDF file. File must exist and be readable.
  @param destPDFPath     The output PDF file. Location must be read-writable.
  
- @note To perform read-only operations on a PDF, destPDFPath may be set to @"/dev/null"
+ @note To perform read-only operations on a PDF, destPDFPath may be nil, in which case nothing is written when executing the session.
  
  @warning Source and destination must not be the same.
  */
@@ -95,12 +95,22 @@ typedef PDTaskResult (^PDIObjectOperation)(PDISession *session, PDIObject *objec
  @param sourceURL       The input PDF source URL, which must be a file URL. The file must exist and be readable.
  @param destPDFPath     The output PDF file. Location must be read-writable.
  
- @note To perform read-only operations on a PDF, destPDFPath may be set to @"/dev/null"
+ @note To perform read-only operations on a PDF, destPDFPath may be nil, in which case nothing is written when executing the session.
  
  @warning Source and destination must not be the same.
  */
 - (id)initWithSourceURL:(NSURL *)sourceURL destinationPDFPath:(NSString *)destPDFPath;
 
+/**
+ Sets up a new PD session for a source PDF in memory, with the destination PDF (updated version) written to memory.
+ 
+ @param sourceData      The input PDF data. The data is retained by the session, and must not be mutated while the session exists.
+ @param destData        The output PDF data. Its content is replaced with the updated PDF when -execute is called. May be nil for read-only operations.
+ 
+ @warning Source and destination must not be the same object.
+ */
+- (id)initWithSourceData:(NSData *)sourceData destinationData:(NSMutableData *)destData;
+
 ///---------------------------------------
 /// @name Document-wide operations
 ///---------------------------------------
@@ -275,12 +285,12 @@ typedef PDTaskResult (^PDIObjectOperation)(PDISession *session, PDIObject *objec
 @property (nonatomic, readonly, strong) PDIObject *infoObject;
 
 /**
- The source PDF path.
+ The source PDF path, or nil if the session was set up with data.
  */
 @property (nonatomic, readonly, copy) NSString *sourcePDFPath;
 
 /**
- The destination PDF path.
+ The destination PDF path, or nil if the session was set up with data.
  */
 @property (nonatomic, readonly, copy) NSString *destPDFPath;
 
@@ -294,6 +304,11 @@ typedef PDTaskResult (^PDIObjectOperation)(PDISession *session, PDIObject *objec
  */
 @property (nonatomic, readonly) NSInteger totalObjectCount;
 
+/**
+ I/O statistics for the session's input and output, e.g. for spotting pathological documents. The statistics cover the session so far, and are final once -execute has been called.
+ */
+@property (nonatomic, readonly) PDIOStats ioStats;
+
 #ifdef PD_SUPPORT_CRYPTO
 
 /**
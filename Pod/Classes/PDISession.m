@@ -53,6 +53,11 @@
     NSString *_documentInstanceID;
     NSMutableDictionary *_pageDict;
     BOOL _fetchedDocIDs;
+    NSData *_sourceData;
+    NSMutableData *_destData;
+    char *_outputBuffer;
+    PDSize _outputLength;
+    PDIOStats _ioStats;
 }
 
 @end
@@ -77,6 +82,7 @@
 {
     PDRelease(_parser);
     PDRelease(_pipe);
+    free(_outputBuffer);
     
     pd_pdf_conversion_discard();
 }
@@ -92,8 +98,8 @@
         if ([sourcePDFPath isEqualToString:destPDFPath]) {
             [NSException raise:NSInvalidArgumentException format:@"Input source and destination source must not be the same file."];
         }
-        if (nil == sourcePDFPath || nil == destPDFPath) {
-            [NSException raise:NSInvalidArgumentException format:@"Source and destination must be non-nil."];
+        if (nil == sourcePDFPath) {
+            [NSException raise:NSInvalidArgumentException format:@"Source must be non-nil."];
         }
         _sourcePDFPath = sourcePDFPath;
         _destPDFPath = destPDFPath;
@@ -104,26 +110,59 @@
             return nil;
         }
         
-        if (! PDPipePrepare(_pipe)) {
-            PDError("PDPipePrepare() failure");
-            PDRelease(_pipe);
-            _pipe = NULL;
-            return nil;
-        }
+        if (! [self preparePipe]) return nil;
+    }
+    return self;
+}
+
+- (id)initWithSourceData:(NSData *)sourceData destinationData:(NSMutableData *)destData
+{
+    self = [super init];
+    if (self) {
+        pd_pdf_conversion_use();
         
-        _parser = PDRetain(PDPipeGetParser(_pipe));
+        _sessionDict = [[NSMutableDictionary alloc] init];
         
-        // to avoid issues later on, we also set up the catalog here
-        if ([self numberOfPages] == 0) {
-            PDError("numberOfPages == 0 (this is considered a failure)");
+        if (nil == sourceData) {
+            [NSException raise:NSInvalidArgumentException format:@"Source must be non-nil."];
+        }
+        if (sourceData == destData) {
+            [NSException raise:NSInvalidArgumentException format:@"Input source and destination source must not be the same data object."];
+        }
+        _sourceData = sourceData;
+        _destData = destData;
+        _pipe = PDPipeCreateWithBuffers([sourceData bytes], [sourceData length], destData ? &_outputBuffer : NULL, destData ? &_outputLength : NULL);
+        if (NULL == _pipe) {
+            PDError("PDPipeCreateWithBuffers() failure");
             return nil;
         }
         
-        _pageDict = [[NSMutableDictionary alloc] init];
+        if (! [self preparePipe]) return nil;
     }
     return self;
 }
 
+- (BOOL)preparePipe
+{
+    if (! PDPipePrepare(_pipe)) {
+        PDError("PDPipePrepare() failure");
+        PDRelease(_pipe);
+        _pipe = NULL;
+        return NO;
+    }
+    
+    _parser = PDRetain(PDPipeGetParser(_pipe));
+    
+    // to avoid issues later on, we also set up the catalog here
+    if ([self numberOfPages] == 0) {
+        PDError("numberOfPages == 0 (this is considered a failure)");
+        return NO;
+    }
+    
+    _pageDict = [[NSMutableDictionary alloc] init];
+    return YES;
+}
+
 - (id)initWithSourceURL:(NSURL *)sourceURL destinationPDFPath:(NSString *)destPDFPath
 {
     if ([sourceURL isFileURL]) {
@@ -138,10 +177,19 @@
     NSAssert(_pipe, @"-execute called more than once, or initialization failed in PDISession");
     
     _objectSum = PDPipeExecute(_pipe);
+    PDPipeGetStats(_pipe, &_ioStats);
     
     PDRelease(_pipe);
     _pipe = NULL;
     
+    if (_destData) {
+        // the output buffer is final once the pipe has executed
+        [_destData setLength:0];
+        if (_outputBuffer) [_destData appendBytes:_outputBuffer length:_outputLength];
+        free(_outputBuffer);
+        _outputBuffer = NULL;
+    }
+    
     return _objectSum != -1;
 }
 
@@ -389,6 +437,12 @@
     return PDParserGetTotalObjectCount(_parser);
 }
 
+- (PDIOStats)ioStats
+{
+    if (_pipe) PDPipeGetStats(_pipe, &_ioStats);
+    return _ioStats;
+}
+
 - (void)setupDocumentIDs
 {
     _fetchedDocIDs = YES;